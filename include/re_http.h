@@ -85,6 +85,7 @@ struct http_msg {
 	struct mbuf *_mb;      /**< Buffer containing the HTTP message     */
 	struct mbuf *mb;       /**< Buffer containing the HTTP body        */
 	uint32_t clen;         /**< Content length                         */
+	struct mem_arena *arena; /**< Memory arena for the HTTP headers    */
 };
 
 
@@ -12,7 +12,8 @@ enum {
 #ifndef FD_WRITE
 	FD_WRITE  = 1<<1,
 #endif
-	FD_EXCEPT = 1<<2
+	FD_EXCEPT = 1<<2,
+	FD_EDGE   = 1<<3   /**< Edge-triggered, where supported */
 };
 
 
@@ -52,6 +53,59 @@ void re_thread_leave(void);
 void re_set_mutex(void *mutexp);
 
 
+/* Cross-thread tasks */
+struct re;
+
+/**
+ * Defines the task work handler, called in the target event loop
+ *
+ * @param arg Handler argument
+ *
+ * @return 0 if success, otherwise errorcode
+ */
+typedef int  (re_async_work_h)(void *arg);
+
+/**
+ * Defines the task completion handler, called in the posting event loop
+ *
+ * @param err Result of the work handler
+ * @param arg Handler argument
+ */
+typedef void (re_async_h)(int err, void *arg);
+
+struct re *re_thread_current(void);
+int  re_thread_async(struct re *re, re_async_work_h *workh, re_async_h *cb,
+		     void *arg);
+int  re_main_post(re_async_work_h *workh, re_async_h *cb, void *arg);
+
+
+/* Pool of event loop threads */
+struct re_pool;
+
+/**
+ * Defines the pool worker start handler, called in the worker thread
+ *
+ * @param idx Worker index
+ * @param arg Handler argument
+ *
+ * @return 0 if success, otherwise errorcode
+ */
+typedef int  (re_pool_start_h)(unsigned idx, void *arg);
+
+/**
+ * Defines the pool worker stop handler, called in the worker thread
+ *
+ * @param idx Worker index
+ * @param arg Handler argument
+ */
+typedef void (re_pool_stop_h)(unsigned idx, void *arg);
+
+int      re_pool_alloc(struct re_pool **poolp, unsigned n,
+		       re_pool_start_h *starth, re_pool_stop_h *stoph,
+		       void *arg);
+unsigned re_pool_count(const struct re_pool *pool);
+
+
 /** Polling methods */
 enum poll_method {
 	METHOD_NULL = 0,
@@ -59,6 +113,7 @@ enum poll_method {
 	METHOD_SELECT,
 	METHOD_EPOLL,
 	METHOD_KQUEUE,
+	METHOD_IO_URING,
 	/* sep */
 	METHOD_MAX
 };
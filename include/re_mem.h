@@ -21,6 +21,15 @@ struct memstat {
 	size_t blocks_peak;  /**< Peak blocks allocated        */
 	size_t size_min;     /**< Lowest block size allocated  */
 	size_t size_max;     /**< Largest block size allocated */
+	size_t slab_hits;    /**< Allocations from slab caches */
+	size_t slab_misses;  /**< Slab allocations from malloc */
+	size_t slab_cached;  /**< Free blocks in slab caches   */
+};
+
+/** Memory allocator backends */
+enum mem_backend {
+	MEM_BACKEND_MALLOC = 0,  /**< malloc() for every object      */
+	MEM_BACKEND_SLAB,        /**< Per-thread size-class caches   */
 };
 
 void    *mem_alloc(size_t size, mem_destroy_h *dh);
@@ -31,12 +40,22 @@ void    *mem_reallocarray(void *ptr, size_t nmemb,
 void    *mem_ref(void *data);
 void    *mem_deref(void *data);
 uint32_t mem_nrefs(const void *data);
+int      mem_backend_set(enum mem_backend backend);
 
 void     mem_debug(void);
 void     mem_threshold_set(ssize_t n);
 struct re_printf;
 int      mem_status(struct re_printf *pf, void *unused);
 int      mem_get_stat(struct memstat *mstat);
+void     mem_slab_stats(size_t *hits, size_t *misses, size_t *cached);
+
+
+/* Memory arena */
+struct mem_arena;
+
+int   mem_arena_alloc(struct mem_arena **arenap, size_t size);
+void *mem_arena_zalloc(struct mem_arena *arena, size_t size,
+		       mem_destroy_h *dh);
 
 
 /* Secure memory functions */
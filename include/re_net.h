@@ -53,6 +53,7 @@ void net_sock_close(void);
 /* Net socket options */
 int net_sockopt_blocking_set(int fd, bool blocking);
 int net_sockopt_reuse_set(int fd, bool reuse);
+int net_sockopt_reuseport_set(int fd, bool reuse);
 
 
 /* Net interface (if.c) */
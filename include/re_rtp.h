@@ -13,7 +13,14 @@ enum {
 };
 
 
-/** Defines the RTP header */
+/**
+ * Defines the RTP header
+ *
+ * The arrival time rx_ts is set by rtp_hdr_decode(), and by the RTP socket
+ * from the kernel timestamp if enabled. Applications that fill in a header
+ * themselves, e.g. for jbuf_put(), must set it to zero if unknown, the
+ * current time is then used.
+ */
 struct rtp_header {
 	uint8_t  ver;       /**< RTP version number     */
 	bool     pad;       /**< Padding bit            */
@@ -29,6 +36,7 @@ struct rtp_header {
 		uint16_t type;  /**< Defined by profile     */
 		uint16_t len;   /**< Number of 32-bit words */
 	} x;
+	uint64_t rx_ts;     /**< Arrival time [us], must be 0 if unknown */
 };
 
 /** RTCP Packet Types */
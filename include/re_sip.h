@@ -209,6 +209,8 @@ struct sip_msg {
 	uint64_t tag;          /**< Opaque tag                           */
 	enum sip_transp tp;    /**< SIP Transport                        */
 	bool req;              /**< True if Request, False if Response  */
+	bool lazy;             /**< True if headers are not decoded yet */
+	struct mem_arena *arena; /**< Memory arena for the SIP Headers   */
 };
 
 /** SIP Loop-state */
@@ -297,6 +299,11 @@ int sip_drequestf(struct sip_request **reqp, struct sip *sip, bool stateful,
 		  const char *met, struct sip_dialog *dlg, uint32_t cseq,
 		  struct sip_auth *auth, sip_send_h *sendh, sip_resp_h *resph,
 		  void *arg, const char *fmt, ...);
+int sip_drequest(struct sip_request **reqp, struct sip *sip, bool stateful,
+		 const char *met, struct sip_dialog *dlg, uint32_t cseq,
+		 struct sip_auth *auth, sip_send_h *sendh, sip_resp_h *resph,
+		 void *arg, const char *hdrs, const char *ctype,
+		 struct mbuf *body);
 void sip_request_cancel(struct sip_request *req);
 bool sip_request_loops(struct sip_loopstate *ls, uint16_t scode);
 void sip_loopstate_reset(struct sip_loopstate *ls);
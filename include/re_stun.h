@@ -213,6 +213,7 @@ uint16_t stun_msg_type(const struct stun_msg *msg);
 uint16_t stun_msg_class(const struct stun_msg *msg);
 uint16_t stun_msg_method(const struct stun_msg *msg);
 bool stun_msg_mcookie(const struct stun_msg *msg);
+bool stun_msg_detect(const struct mbuf *mb);
 const uint8_t *stun_msg_tid(const struct stun_msg *msg);
 struct stun_attr *stun_msg_attr(const struct stun_msg *msg, uint16_t type);
 struct stun_attr *stun_msg_attr_apply(const struct stun_msg *msg,
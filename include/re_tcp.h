@@ -58,6 +58,9 @@ int  tcp_accept(struct tcp_conn **tcp, struct tcp_sock *ts, tcp_estab_h *eh,
 void tcp_reject(struct tcp_sock *ts);
 int  tcp_sock_local_get(const struct tcp_sock *ts, struct sa *local);
 int  tcp_settos(struct tcp_sock *ts, uint32_t tos);
+int  tcp_sock_reuseport_set(struct tcp_sock *ts, bool reuse);
+void tcp_sock_acceptbudget_set(struct tcp_sock *ts, uint32_t budget);
+int  tcp_sock_defer_accept_set(struct tcp_sock *ts, uint32_t timeout);
 int  tcp_conn_settos(struct tcp_conn *tc, uint32_t tos);
 
 
@@ -68,20 +71,25 @@ int  tcp_conn_alloc(struct tcp_conn **tcp, const struct sa *peer,
 int  tcp_conn_bind(struct tcp_conn *tc, const struct sa *local);
 int  tcp_conn_connect(struct tcp_conn *tc, const struct sa *peer);
 int  tcp_send(struct tcp_conn *tc, struct mbuf *mb);
+int  tcp_send_vec(struct tcp_conn *tc, struct mbuf **mbv, size_t n);
 int  tcp_set_send(struct tcp_conn *tc, tcp_send_h *sendh);
 void tcp_set_handlers(struct tcp_conn *tc, tcp_estab_h *eh, tcp_recv_h *rh,
 		      tcp_close_h *ch, void *arg);
 void tcp_conn_rxsz_set(struct tcp_conn *tc, size_t rxsz);
+void tcp_conn_rxbudget_set(struct tcp_conn *tc, uint32_t budget);
 void tcp_conn_txqsz_set(struct tcp_conn *tc, size_t txqsz);
 int  tcp_conn_local_get(const struct tcp_conn *tc, struct sa *local);
 int  tcp_conn_peer_get(const struct tcp_conn *tc, struct sa *peer);
 int  tcp_conn_fd(const struct tcp_conn *tc);
 size_t tcp_conn_txqsz(const struct tcp_conn *tc);
+int  tcp_conn_zerocopy_set(struct tcp_conn *tc, bool enable);
 
 
 /* High-level API */
 int  tcp_listen(struct tcp_sock **tsp, const struct sa *local,
 		tcp_conn_h *ch, void *arg);
+int  tcp_listen_reuseport(struct tcp_sock **tsp, const struct sa *local,
+			  tcp_conn_h *ch, void *arg);
 int  tcp_connect(struct tcp_conn **tcp, const struct sa *peer,
 		 tcp_estab_h *eh, tcp_recv_h *rh, tcp_close_h *ch, void *arg);
 int  tcp_connect_bind(struct tcp_conn **tcp, const struct sa *peer,
@@ -12,18 +12,33 @@
  */
 typedef void (tmr_h)(void *arg);
 
+struct tmrh;
+
 /** Defines a timer */
 struct tmr {
 	struct le le;       /**< Linked list element */
 	tmr_h *th;          /**< Timeout handler     */
 	void *arg;          /**< Handler argument    */
 	uint64_t jfs;       /**< Jiffies for timeout */
+	uint64_t seq;       /**< Start sequence      */
+	struct tmrh *tmrh;  /**< Owning timer heap   */
+	uint32_t idx;       /**< Timer heap index    */
+};
+
+/** Timer clock sources */
+enum tmr_clock {
+	TMR_CLOCK_MONOTONIC = 0,  /**< Monotonic clock (default)          */
+	TMR_CLOCK_COARSE,         /**< Faster, coarse monotonic clock     */
 };
 
 
 void     tmr_poll(struct list *tmrl);
 uint64_t tmr_jiffies_usec(void);
 uint64_t tmr_jiffies(void);
+uint64_t tmr_jiffies_cached(void);
+uint64_t tmr_jiffies_update(void);
+void     tmr_clock_set(enum tmr_clock clk);
+void     tmr_clock_cache(bool enable);
 uint64_t tmr_next_timeout(struct list *tmrl);
 void     tmr_debug(void);
 int      tmr_status(struct re_printf *pf, void *unused);
@@ -9,6 +9,14 @@ struct sa;
 struct udp_sock;
 
 
+/** Defines a UDP Datagram for batched sending */
+struct udp_dgram {
+	const struct sa *dst;  /**< Destination network address */
+	struct mbuf *mb;       /**< Buffer to send              */
+	int err;               /**< Returned send result        */
+};
+
+
 /**
  * Defines the UDP Receive handler
  *
@@ -22,16 +30,28 @@ typedef void (udp_error_h)(int err, void *arg);
 
 int  udp_listen(struct udp_sock **usp, const struct sa *local,
 		udp_recv_h *rh, void *arg);
+int  udp_listen_reuseport(struct udp_sock **usp, const struct sa *local,
+			  udp_recv_h *rh, void *arg);
 int  udp_connect(struct udp_sock *us, const struct sa *peer);
 int  udp_open(struct udp_sock **usp, int af);
 int  udp_send(struct udp_sock *us, const struct sa *dst, struct mbuf *mb);
 int  udp_send_anon(const struct sa *dst, struct mbuf *mb);
+int  udp_send_batch(struct udp_sock *us, struct udp_dgram *dv, size_t n);
 int  udp_local_get(const struct udp_sock *us, struct sa *local);
 int  udp_setsockopt(struct udp_sock *us, int level, int optname,
 		    const void *optval, uint32_t optlen);
 int  udp_sockbuf_set(struct udp_sock *us, int size);
 void udp_rxsz_set(struct udp_sock *us, size_t rxsz);
 void udp_rxbuf_presz_set(struct udp_sock *us, size_t rx_presz);
+int  udp_rxpool_set(struct udp_sock *us, uint32_t n);
+void udp_rxpool_stats(const struct udp_sock *us, uint64_t *hits,
+		      uint64_t *misses);
+void udp_rxbudget_set(struct udp_sock *us, uint32_t budget);
+int  udp_gso_set(struct udp_sock *us, bool enable);
+int  udp_gro_set(struct udp_sock *us, bool enable);
+int  udp_tstamp_set(struct udp_sock *us, bool enable);
+uint64_t udp_rx_tstamp(const struct udp_sock *us);
+int  udp_busy_poll_set(struct udp_sock *us, uint32_t usec);
 void udp_handler_set(struct udp_sock *us, udp_recv_h *rh, void *arg);
 void udp_error_handler_set(struct udp_sock *us, udp_error_h *eh);
 int  udp_thread_attach(struct udp_sock *us);
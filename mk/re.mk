@@ -329,6 +329,10 @@ ifneq ($(HAVE_ATOMIC),)
 CFLAGS  += -DHAVE_ATOMIC
 endif
 
+ifneq ($(USE_MEM_ATOMIC),)
+CFLAGS  += -DRE_MEM_ATOMIC
+endif
+
 
 ifeq ($(OS),)
 $(warning Could not detect OS)
@@ -543,6 +547,10 @@ HAVE_EPOLL   := $(shell [ -f $(SYSROOT)/include/sys/epoll.h ] || \
 			[ -f $(SYSROOT)/include/$(MACHINE)/sys/epoll.h ] \
 			&& echo "1")
 endif
+ifeq ($(OS),linux)
+HAVE_IO_URING := $(shell grep -qs IORING_FEAT_EXT_ARG \
+			$(SYSROOT)/include/linux/io_uring.h && echo "1")
+endif
 
 HAVE_RESOLV := $(shell [ -f $(SYSROOT)/include/resolv.h ] && echo "1")
 
@@ -578,6 +586,9 @@ endif
 ifneq ($(HAVE_KQUEUE),)
 CFLAGS  += -DHAVE_KQUEUE
 endif
+ifneq ($(HAVE_IO_URING),)
+CFLAGS  += -DHAVE_IO_URING
+endif
 CFLAGS  += -DHAVE_UNAME
 CFLAGS  += -DHAVE_UNISTD_H
 CFLAGS  += -DHAVE_STRINGS_H
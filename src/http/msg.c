@@ -16,22 +16,17 @@
 
 enum {
 	STARTLINE_MAX = 8192,
+	ARENA_SIZE    = 1024,
 };
 
 
-static void hdr_destructor(void *arg)
-{
-	struct http_hdr *hdr = arg;
-
-	list_unlink(&hdr->le);
-}
-
-
 static void destructor(void *arg)
 {
 	struct http_msg *msg = arg;
 
-	list_flush(&msg->hdrl);
+	/* headers are owned by the arena */
+	list_clear(&msg->hdrl);
+	mem_deref(msg->arena);
 	mem_deref(msg->_mb);
 	mem_deref(msg->mb);
 }
@@ -98,7 +93,7 @@ static inline int hdr_add(struct http_msg *msg, const struct pl *name,
 	struct http_hdr *hdr;
 	int err = 0;
 
-	hdr = mem_zalloc(sizeof(*hdr), hdr_destructor);
+	hdr = mem_arena_zalloc(msg->arena, sizeof(*hdr), NULL);
 	if (!hdr)
 		return ENOMEM;
 
@@ -125,7 +120,7 @@ static inline int hdr_add(struct http_msg *msg, const struct pl *name,
 	}
 
 	if (err)
-		mem_deref(hdr);
+		list_unlink(&hdr->le);
 
 	return err;
 }
@@ -166,6 +161,10 @@ int http_msg_decode(struct http_msg **msgp, struct mbuf *mb, bool req)
 
 	msg->_mb = mem_ref(mb);
 
+	err = mem_arena_alloc(&msg->arena, ARENA_SIZE);
+	if (err)
+		goto out;
+
 	msg->mb = mbuf_alloc(8192);
 	if (!msg->mb) {
 		err = ENOMEM;
@@ -40,7 +40,7 @@ static bool helper_recv_handler(struct sa *src, struct mbuf *mb, void *arg)
 		  comp->id, mbuf_get_left(mb), src);
 #endif
 
-	if (stun_msg_decode(&msg, mb, &ua))
+	if (!stun_msg_detect(mb) || stun_msg_decode(&msg, mb, &ua))
 		return false;
 
 	if (STUN_METHOD_BINDING == stun_msg_method(msg)) {
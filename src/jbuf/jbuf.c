@@ -387,14 +387,14 @@ static void plot_stat(struct jitter_stat *st, uint64_t tr)
  * jbuf_put.
  *
  * @param jb  Jitter buffer
- * @param ts  The timestamp in rtp header.
- * @param seq The sequence number in rtp header.
+ * @param hdr The rtp header, with the kernel arrival time if known
  *
  */
-static void jbuf_jitter_calc(struct jbuf *jb, uint32_t ts)
+static void jbuf_jitter_calc(struct jbuf *jb, const struct rtp_header *hdr)
 {
 	struct jitter_stat *st = &jb->jitst;
-	uint64_t tr = tmr_jiffies();
+	const uint32_t ts = hdr->ts;
+	uint64_t tr = hdr->rx_ts ? hdr->rx_ts / 1000 : tmr_jiffies();
 	int32_t buftime, bufmax, bufmin;
 	int32_t d;
 	int32_t da;
@@ -573,7 +573,7 @@ success:
 	f->mem = mem_ref(mem);
 
 	if (jb->jbtype == JBUF_ADAPTIVE && jb->started)
-		jbuf_jitter_calc(jb, hdr->ts);
+		jbuf_jitter_calc(jb, hdr);
 
 out:
 	lock_rel(jb->lock);
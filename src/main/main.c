@@ -39,6 +39,7 @@
 #include <re_mem.h>
 #include <re_mbuf.h>
 #include <re_list.h>
+#include <re_hash.h>
 #include <re_tmr.h>
 #include <re_main.h>
 #include "main.h"
@@ -46,6 +47,12 @@
 #define __USE_GNU 1
 #include <stdlib.h>
 #include <pthread.h>
+#if defined(HAVE_ATOMIC) && !defined(__STDC_NO_ATOMICS__)
+#include <sched.h>
+#include <stdatomic.h>
+#include <re_mqueue.h>
+#define RE_ASYNC 1
+#endif
 #endif
 
 
@@ -72,6 +79,8 @@
 /** Main loop values */
 enum {
 	MAX_BLOCKING = 500,    /**< Maximum time spent in handler in [ms] */
+	URING_ENTRIES = 256,   /**< Number of io_uring submission entries */
+	TASK_RETRIES = 3,      /**< Attempts to ring the task doorbell    */
 #if defined (FD_SETSIZE)
 	DEFAULT_MAXFDS = FD_SETSIZE
 #else
@@ -85,7 +94,35 @@ struct fhs {
 	int flags;           /**< Polling flags (Read, Write, etc.) */
 	fd_h* fh;            /**< Event handler                     */
 	void* arg;           /**< Handler argument                  */
+#ifdef WIN32
+	struct le le;        /**< Element in fd hash or free list   */
+#endif
+};
+
+#ifdef HAVE_IO_URING
+/** io_uring poll state of a file descriptor */
+struct ufd {
+	uint32_t gen;        /**< Generation of the poll request    */
+	int flags;           /**< Flags of the armed poll request   */
+	bool armed;          /**< Poll request is in flight         */
+	bool multi;          /**< Poll request is multishot         */
 };
+#endif
+
+struct tmrh;
+
+#ifdef RE_ASYNC
+/** Task posted to an event loop */
+struct re_task {
+	struct re_task *next;        /**< Next task in queue                */
+	struct re *origin;           /**< Loop that posted the task         */
+	re_async_work_h *workh;      /**< Work handler                      */
+	re_async_h *cb;              /**< Completion handler                */
+	void *arg;                   /**< Handler argument                  */
+	int err;                     /**< Result of work handler            */
+	bool done;                   /**< Work done, completion pending     */
+};
+#endif
 
 /** Polling loop data */
 struct re {
@@ -97,6 +134,12 @@ struct re {
 	bool polling;                /**< Is polling flag                   */
 	int sig;                     /**< Last caught signal                */
 	struct list tmrl;            /**< List of timers                    */
+	struct tmrh *tmrh;           /**< Timer heap                        */
+
+#ifdef WIN32
+	struct hash *fdh;            /**< Hash of used fhs entries by fd    */
+	struct list freel;           /**< List of free fhs entries          */
+#endif
 
 #ifdef HAVE_POLL
 	struct pollfd *fds;          /**< Event set for poll()              */
@@ -112,10 +155,22 @@ struct re {
 	int kqfd;
 #endif
 
+#ifdef HAVE_IO_URING
+	struct uring *uring;         /**< io_uring instance                 */
+	struct ufd *ufds;            /**< Poll state per fd for io_uring    */
+#endif
+
 #ifdef HAVE_PTHREAD
 	pthread_mutex_t mutex;       /**< Mutex for thread synchronization  */
 	pthread_mutex_t *mutexp;     /**< Pointer to active mutex           */
 #endif
+
+#ifdef RE_ASYNC
+	_Atomic(struct re_task *) taskq;  /**< Posted tasks, newest first  */
+	_Atomic(struct mqueue *) mq;      /**< Task doorbell, owner only   */
+	atomic_bool bell;                 /**< Doorbell rung, not drained  */
+	atomic_uint posters;              /**< Threads using the doorbell  */
+#endif
 };
 
 static struct re global_re = {
@@ -127,6 +182,11 @@ static struct re global_re = {
 	false,
 	0,
 	LIST_INIT,
+	NULL,
+#ifdef WIN32
+	NULL,
+	LIST_INIT,
+#endif
 #ifdef HAVE_POLL
 	NULL,
 #endif
@@ -138,6 +198,10 @@ static struct re global_re = {
 	NULL,
 	-1,
 #endif
+#ifdef HAVE_IO_URING
+	NULL,
+	NULL,
+#endif
 #ifdef HAVE_PTHREAD
 #if MAIN_DEBUG && defined (PTHREAD_ERRORCHECK_MUTEX_INITIALIZER_NP)
 	PTHREAD_ERRORCHECK_MUTEX_INITIALIZER_NP,
@@ -146,9 +210,23 @@ static struct re global_re = {
 #endif
 	&global_re.mutex,
 #endif
+#ifdef RE_ASYNC
+	NULL,
+	NULL,
+	false,
+	0,
+#endif
 };
 
 
+#ifdef RE_ASYNC
+static int  async_init(struct re *re);
+static void async_close(struct re *re);
+#else
+#define async_close(x)  /**< Stub */
+#endif
+
+
 #ifdef HAVE_PTHREAD
 
 static void poll_close(struct re *re);
@@ -159,8 +237,16 @@ static pthread_key_t  pt_key;
 
 static void thread_destructor(void *arg)
 {
-	poll_close(arg);
-	free(arg);
+	struct re *re = arg;
+
+	/* the key value is cleared before the destructor is called */
+	pthread_setspecific(pt_key, re);
+	async_close(re);
+	pthread_setspecific(pt_key, NULL);
+
+	poll_close(re);
+	mem_deref(re->tmrh);
+	free(re);
 }
 
 
@@ -220,6 +306,14 @@ static struct re *re_get(void)
 #endif
 
 #ifdef WIN32
+static bool fhs_fd_handler(struct le *le, void *arg)
+{
+	const struct fhs *fhs = le->data;
+
+	return fhs->fd == *(int *)arg;
+}
+
+
 /**
  * This code emulates POSIX numbering. There is no locking,
  * so zero thread-safety.
@@ -230,24 +324,18 @@ static struct re *re_get(void)
  * @return fhs index if success, otherwise -1
  */
 static int lookup_fd_index(struct re* re, int fd) {
-	int i;
+	struct le *le;
 
-	for (i = 0; i < re->nfds; i++) {
-		if (!re->fhs[i].fh)
-			continue;
+	le = hash_lookup(re->fdh, (uint32_t)fd, fhs_fd_handler, &fd);
 
-		if (re->fhs[i].fd == fd)
-			return i;
-	}
+	/* if nothing is found take the first free handler */
+	if (!le)
+		le = list_head(&re->freel);
 
-	/* if nothing is found a linear search for the first
-	 * zeroed handler */
-	for (i = 0; i < re->maxfds; i++) {
-		if (!re->fhs[i].fh)
-			return i;
-	}
+	if (!le)
+		return -1;
 
-	return -1;
+	return (int)((struct fhs *)le->data - re->fhs);
 }
 #endif
 
@@ -326,6 +414,8 @@ static int set_epoll_fds(struct re *re, int fd, int flags)
 			event.events |= EPOLLOUT;
 		if (flags & FD_EXCEPT)
 			event.events |= EPOLLERR;
+		if (flags & FD_EDGE)
+			event.events |= EPOLLET;
 
 		/* Try to add it first */
 		if (-1 == epoll_ctl(re->epfd, EPOLL_CTL_ADD, fd, &event)) {
@@ -367,6 +457,7 @@ static int set_epoll_fds(struct re *re, int fd, int flags)
 static int set_kqueue_fds(struct re *re, int fd, int flags)
 {
 	struct kevent kev[2];
+	const uint16_t kflags = (flags & FD_EDGE) ? EV_ADD | EV_CLEAR : EV_ADD;
 	int r, n = 0;
 
 	memset(kev, 0, sizeof(kev));
@@ -379,11 +470,11 @@ static int set_kqueue_fds(struct re *re, int fd, int flags)
 	memset(kev, 0, sizeof(kev));
 
 	if (flags & FD_WRITE) {
-		EV_SET(&kev[n], fd, EVFILT_WRITE, EV_ADD, 0, 0, 0);
+		EV_SET(&kev[n], fd, EVFILT_WRITE, kflags, 0, 0, 0);
 		++n;
 	}
 	if (flags & FD_READ) {
-		EV_SET(&kev[n], fd, EVFILT_READ, EV_ADD, 0, 0, 0);
+		EV_SET(&kev[n], fd, EVFILT_READ, kflags, 0, 0, 0);
 		++n;
 	}
 
@@ -403,6 +494,68 @@ static int set_kqueue_fds(struct re *re, int fd, int flags)
 #endif
 
 
+#ifdef HAVE_IO_URING
+static inline uint64_t uring_data(int fd, const struct ufd *u)
+{
+	return (uint64_t)u->gen << 32 | (uint32_t)fd;
+}
+
+
+/*
+ * Poll requests of level-triggered fds are one-shot and re-armed after
+ * the handler is called. Edge-triggered fds get multishot requests where
+ * the kernel supports them, which stay armed, and are only replaced when
+ * fd_listen() is called again to re-arm. A request that is replaced gets a
+ * new generation, late completions of the old one are then ignored.
+ */
+static int set_uring_fds(struct re *re, int fd, int flags)
+{
+	struct ufd *u;
+	int err = 0;
+
+	if (!re->uring || !re->ufds)
+		return EBADFD;
+
+	u = &re->ufds[fd];
+
+	if (u->armed && u->flags == flags && !u->multi)
+		return 0;
+
+	if (u->armed) {
+		/* submit now, the poll request holds a file reference */
+		err = uring_poll_remove(re->uring, uring_data(fd, u), !flags);
+		if (err) {
+			DEBUG_WARNING("uring: poll remove: fd=%d (%m)\n",
+				      fd, err);
+		}
+
+		u->armed = false;
+	}
+
+	u->flags = flags;
+
+	if (!flags)
+		return err;
+
+	if (++u->gen == 0)
+		u->gen = 1;
+
+	u->multi = (flags & FD_EDGE) && uring_multishot(re->uring);
+
+	err = uring_poll_add(re->uring, fd, flags, u->multi,
+			     uring_data(fd, u));
+	if (err) {
+		DEBUG_WARNING("uring: poll add: fd=%d (%m)\n", fd, err);
+		return err;
+	}
+
+	u->armed = true;
+
+	return 0;
+}
+#endif
+
+
 /**
  * Rebuild the file descriptor mapping table. This must be done whenever
  * the polling method is changed.
@@ -437,6 +590,12 @@ static int rebuild_fds(struct re *re)
 			break;
 #endif
 
+#ifdef HAVE_IO_URING
+		case METHOD_IO_URING:
+			err = set_uring_fds(re, i, re->fhs[i].flags);
+			break;
+#endif
+
 		default:
 			break;
 		}
@@ -514,6 +673,23 @@ static int poll_init(struct re *re)
 		break;
 #endif
 
+#ifdef HAVE_IO_URING
+	case METHOD_IO_URING:
+		if (!re->ufds) {
+			re->ufds = mem_zalloc(re->maxfds * sizeof(*re->ufds),
+					      NULL);
+			if (!re->ufds)
+				return ENOMEM;
+		}
+
+		if (!re->uring) {
+			int err = uring_alloc(&re->uring, URING_ENTRIES);
+			if (err)
+				return err;
+		}
+		break;
+#endif
+
 	default:
 		break;
 	}
@@ -528,6 +704,15 @@ static void poll_close(struct re *re)
 
 	re->fhs = mem_deref(re->fhs);
 	re->maxfds = 0;
+	re->nfds = 0;
+
+#ifdef WIN32
+	re->fdh = mem_deref(re->fdh);
+	list_init(&re->freel);
+#endif
+
+	if (list_isempty(&re->tmrl))
+		re->tmrh = mem_deref(re->tmrh);
 
 #ifdef HAVE_POLL
 	re->fds = mem_deref(re->fds);
@@ -551,6 +736,11 @@ static void poll_close(struct re *re)
 
 	re->evlist = mem_deref(re->evlist);
 #endif
+
+#ifdef HAVE_IO_URING
+	re->uring = mem_deref(re->uring);
+	re->ufds  = mem_deref(re->ufds);
+#endif
 }
 
 
@@ -590,6 +780,10 @@ static int poll_setup(struct re *re)
  * @param arg    Handler argument
  *
  * @return 0 if success, otherwise errorcode
+ *
+ * @note With FD_EDGE the handler is only called when the fd becomes ready,
+ *       so it must consume all pending data or call fd_listen() again to
+ *       re-arm. Polling methods without edge support ignore the flag.
  */
 int fd_listen(int fd, int flags, fd_h *fh, void *arg)
 {
@@ -634,9 +828,25 @@ int fd_listen(int fd, int flags, fd_h *fh, void *arg)
 		re->fhs[i].flags = flags;
 		re->fhs[i].fh    = fh;
 		re->fhs[i].arg   = arg;
+
+#ifdef WIN32
+		list_unlink(&re->fhs[i].le);
+		if (fh)
+			hash_append(re->fdh, (uint32_t)fd, &re->fhs[i].le,
+				    &re->fhs[i]);
+		else
+			list_append(&re->freel, &re->fhs[i].le, &re->fhs[i]);
+#endif
 	}
 
-	re->nfds = max(re->nfds, i+1);
+	if (fh) {
+		re->nfds = max(re->nfds, i+1);
+	}
+	else if (re->fhs) {
+		/* Shrink the active range if the last entry was removed */
+		while (re->nfds > 0 && !re->fhs[re->nfds - 1].fh)
+			--re->nfds;
+	}
 
 	switch (re->method) {
 
@@ -660,6 +870,12 @@ int fd_listen(int fd, int flags, fd_h *fh, void *arg)
 		break;
 #endif
 
+#ifdef HAVE_IO_URING
+	case METHOD_IO_URING:
+		err = set_uring_fds(re, fd, flags);
+		break;
+#endif
+
 	default:
 		break;
 	}
@@ -687,6 +903,92 @@ void fd_close(int fd)
 }
 
 
+#ifdef HAVE_IO_URING
+/**
+ * Polling loop for io_uring, which returns one completion per ready fd
+ *
+ * @param re Poll state
+ * @param to Timeout in [ms], 0 to wait forever
+ *
+ * @return 0 if success, otherwise errorcode
+ */
+static int poll_uring(struct re *re, uint64_t to)
+{
+	uint64_t data;
+	int32_t res;
+	bool more;
+	int err;
+
+	re_unlock(re);
+	err = uring_wait(re->uring, to);
+	re_lock(re);
+
+	if (err)
+		return err;
+
+	tmr_jiffies_update();
+
+	re->update = false;
+
+	/* the ring is released if the method is changed from a handler */
+	while (re->uring && uring_next(re->uring, &data, &res, &more)) {
+
+		const int fd = (int)(uint32_t)data;
+		struct ufd *u;
+		int flags = 0;
+
+		if (fd < 0 || fd >= re->maxfds)
+			continue;
+
+		u = &re->ufds[fd];
+
+		/* cancelled or replaced poll request */
+		if (!u->armed || uring_data(fd, u) != data)
+			continue;
+
+		/* a multishot request may also be ended by the kernel */
+		u->armed = more;
+
+		if (res < 0) {
+			DEBUG_INFO("uring: fd=%d (%m)\n", fd, -res);
+			flags |= FD_EXCEPT;
+		}
+		else {
+			if (res & POLLIN)
+				flags |= FD_READ;
+			if (res & POLLOUT)
+				flags |= FD_WRITE;
+			if (res & (POLLERR|POLLHUP|POLLNVAL))
+				flags |= FD_EXCEPT;
+		}
+
+		if (re->fhs[fd].fh) {
+#if MAIN_DEBUG
+			fd_handler(re, fd, flags);
+#else
+			re->fhs[fd].fh(flags, re->fhs[fd].arg);
+#endif
+		}
+
+		/* Check if polling method was changed */
+		if (re->update) {
+			re->update = false;
+			return 0;
+		}
+
+		/* re-arm, unless the handler did already */
+		if (!u->armed && re->fhs[fd].flags) {
+			err = set_uring_fds(re, fd, re->fhs[fd].flags);
+			if (err)
+				return err;
+		}
+	}
+
+	return 0;
+}
+#endif
+
+
 /**
  * Polling loop
  *
@@ -697,7 +999,7 @@ void fd_close(int fd)
 static int fd_poll(struct re *re)
 {
 	const uint64_t to = tmr_next_timeout(&re->tmrl);
-	int i, n, index;
+	int i, n, nmax, index;
 #ifdef HAVE_SELECT
 	fd_set rfds, wfds, efds;
 #endif
@@ -757,6 +1059,11 @@ static int fd_poll(struct re *re)
 		break;
 #endif
 
+#ifdef HAVE_IO_URING
+	case METHOD_IO_URING:
+		return poll_uring(re, to);
+#endif
+
 #ifdef HAVE_KQUEUE
 	case METHOD_KQUEUE: {
 		struct timespec timeout;
@@ -781,8 +1088,28 @@ static int fd_poll(struct re *re)
 	if (n < 0)
 		return errno;
 
+	tmr_jiffies_update();
+
+	/* only a method change from within a handler below aborts dispatch,
+	 * events of an edge-triggered fd would otherwise be lost */
+	re->update = false;
+
+	/* epoll and kqueue return a dense event list, which must be walked
+	 * in full even if handlers close fds and shrink nfds meanwhile */
+	switch (re->method) {
+
+	case METHOD_EPOLL:
+	case METHOD_KQUEUE:
+		nmax = n;
+		break;
+
+	default:
+		nmax = re->nfds;
+		break;
+	}
+
 	/* Check for events */
-	for (i=0; (n > 0) && (i < re->nfds); i++) {
+	for (i=0; (n > 0) && (i < nmax); i++) {
 		int fd, flags = 0;
 
 		switch (re->method) {
@@ -918,6 +1245,7 @@ int fd_setsize(int maxfds)
 	struct re *re = re_get();
 
 	if (!maxfds) {
+		async_close(re);
 		fd_debug();
 		poll_close(re);
 		return 0;
@@ -933,6 +1261,23 @@ int fd_setsize(int maxfds)
 		re->fhs = mem_zalloc(re->maxfds * sizeof(*re->fhs), NULL);
 		if (!re->fhs)
 			return ENOMEM;
+
+#ifdef WIN32
+		{
+			int i, err;
+
+			err = hash_alloc(&re->fdh,
+					 hash_valid_size(re->maxfds));
+			if (err) {
+				re->fhs = mem_deref(re->fhs);
+				return err;
+			}
+
+			for (i=0; i<re->maxfds; i++)
+				list_append(&re->freel, &re->fhs[i].le,
+					    &re->fhs[i]);
+		}
+#endif
 	}
 
 	return 0;
@@ -1003,6 +1348,12 @@ int re_main(re_signal_h *signalh)
 	if (err)
 		goto out;
 
+#ifdef RE_ASYNC
+	err = async_init(re);
+	if (err)
+		goto out;
+#endif
+
 	DEBUG_INFO("Using async I/O polling method: `%s'\n",
 		   poll_method_name(re->method));
 
@@ -1124,6 +1475,17 @@ int poll_method_set(enum poll_method method)
 #ifdef HAVE_KQUEUE
 	case METHOD_KQUEUE:
 		break;
+#endif
+#ifdef HAVE_IO_URING
+	case METHOD_IO_URING:
+		if (!uring_check()) {
+			DEBUG_NOTICE("io_uring not supported,"
+				     " falling back to epoll\n");
+			method = METHOD_EPOLL;
+			if (!epoll_check())
+				return EINVAL;
+		}
+		break;
 #endif
 	default:
 		DEBUG_WARNING("poll method not supported: '%s'\n",
@@ -1131,6 +1493,14 @@ int poll_method_set(enum poll_method method)
 		return EINVAL;
 	}
 
+#ifdef HAVE_IO_URING
+	/* pending poll requests would hold references to the files */
+	if (method != METHOD_IO_URING) {
+		re->uring = mem_deref(re->uring);
+		re->ufds  = mem_deref(re->ufds);
+	}
+#endif
+
 	re->method = method;
 	re->update = true;
 
@@ -1200,7 +1570,9 @@ void re_thread_close(void)
 
 	re = pthread_getspecific(pt_key);
 	if (re) {
+		async_close(re);
 		poll_close(re);
+		mem_deref(re->tmrh);
 		free(re);
 		pthread_setspecific(pt_key, NULL);
 	}
@@ -1247,6 +1619,228 @@ void re_set_mutex(void *mutexp)
 }
 
 
+#ifdef RE_ASYNC
+/*
+ * The doorbell is rung once per batch of tasks, tasks posted while it is
+ * pending rely on that. A full queue already has wakeups pending, and the
+ * loop drains all tasks per wakeup. Other errors are retried, and if the
+ * doorbell stays broken the tasks are left queued and the bell is reset,
+ * so that the next post rings it again. The posters counter keeps the
+ * mqueue alive while it is used here, see async_close().
+ */
+static void task_post(struct re *re, struct re_task *task)
+{
+	struct re_task *head = atomic_load(&re->taskq);
+	struct mqueue *mq;
+	int i, err = 0;
+
+	do {
+		task->next = head;
+	} while (!atomic_compare_exchange_weak(&re->taskq, &head, task));
+
+	/* only the first task of a batch rings the doorbell */
+	if (atomic_exchange(&re->bell, true))
+		return;
+
+	atomic_fetch_add(&re->posters, 1);
+
+	/* tasks are picked up when the loop starts */
+	mq = atomic_load(&re->mq);
+
+	for (i=0; mq && i<TASK_RETRIES; i++) {
+
+		err = mqueue_push(mq, 0, NULL);
+		if (!err || err == EAGAIN)
+			break;
+
+		sched_yield();
+	}
+
+	atomic_fetch_sub(&re->posters, 1);
+
+	if (!mq || (err && err != EAGAIN)) {
+
+		if (mq) {
+			DEBUG_WARNING("async: doorbell: %m\n", err);
+		}
+
+		atomic_store(&re->bell, false);
+	}
+}
+
+
+static void task_drain(struct re *re)
+{
+	struct re_task *task, *fifo = NULL;
+
+	/* tasks posted from now on must ring the doorbell again */
+	atomic_store(&re->bell, false);
+
+	task = atomic_exchange(&re->taskq, NULL);
+
+	/* the queue is a stack, restore posting order */
+	while (task) {
+		struct re_task *next = task->next;
+
+		task->next = fifo;
+		fifo = task;
+		task = next;
+	}
+
+	while (fifo) {
+
+		task = fifo;
+		fifo = task->next;
+
+		if (task->done) {
+			task->cb(task->err, task->arg);
+			mem_deref(task);
+			continue;
+		}
+
+		task->err = task->workh(task->arg);
+
+		if (task->cb) {
+			task->done = true;
+			task_post(task->origin, task);
+		}
+		else {
+			mem_deref(task);
+		}
+	}
+}
+
+
+static void async_handler(int id, void *data, void *arg)
+{
+	(void)id;
+	(void)data;
+
+	task_drain(arg);
+}
+
+
+static int async_init(struct re *re)
+{
+	struct mqueue *mq;
+	int err;
+
+	if (atomic_load(&re->mq))
+		return 0;
+
+	err = mqueue_alloc(&mq, async_handler, re);
+	if (err)
+		return err;
+
+	atomic_store(&re->mq, mq);
+
+	/* tasks posted before the loop was started */
+	if (atomic_load(&re->taskq))
+		return mqueue_push(mq, 0, NULL);
+
+	return 0;
+}
+
+
+static void async_close(struct re *re)
+{
+	struct re_task *task;
+	struct mqueue *mq;
+
+	mq = atomic_exchange(&re->mq, NULL);
+
+	/* wait for threads that are ringing the doorbell */
+	while (atomic_load(&re->posters))
+		sched_yield();
+
+	mem_deref(mq);
+
+	task = atomic_exchange(&re->taskq, NULL);
+	while (task) {
+		struct re_task *next = task->next;
+
+		mem_deref(task);
+		task = next;
+	}
+}
+#endif
+
+
+/**
+ * Get the event loop of this thread, which can be passed to
+ * re_thread_async() from other threads
+ *
+ * @return Event loop of this thread
+ */
+struct re *re_thread_current(void)
+{
+	return re_get();
+}
+
+
+/**
+ * Post a task to the event loop of another thread. The work handler is
+ * called from the target loop without taking the re_thread_enter() mutex
+ * in the posting thread. The optional completion handler is called with
+ * the result from the loop of the posting thread, or from the main loop
+ * if the task was posted from a non-re thread.
+ *
+ * @param re    Target event loop, see re_thread_current()
+ * @param workh Work handler
+ * @param cb    Optional completion handler
+ * @param arg   Handler argument
+ *
+ * @return 0 if success, otherwise errorcode
+ *
+ * @note Tasks that are pending when the target loop is closed are dropped.
+ *       The target loop must not be freed while tasks are posted to it.
+ */
+int re_thread_async(struct re *re, re_async_work_h *workh, re_async_h *cb,
+		    void *arg)
+{
+#ifdef RE_ASYNC
+	struct re_task *task;
+
+	if (!re || !workh)
+		return EINVAL;
+
+	task = mem_zalloc(sizeof(*task), NULL);
+	if (!task)
+		return ENOMEM;
+
+	task->origin = re_get();
+	task->workh  = workh;
+	task->cb     = cb;
+	task->arg    = arg;
+
+	task_post(re, task);
+
+	return 0;
+#else
+	(void)re;
+	(void)workh;
+	(void)cb;
+	(void)arg;
+	return ENOSYS;
+#endif
+}
+
+
+/**
+ * Post a task to the main event loop, see re_thread_async()
+ *
+ * @param workh Work handler
+ * @param cb    Optional completion handler
+ * @param arg   Handler argument
+ *
+ * @return 0 if success, otherwise errorcode
+ */
+int re_main_post(re_async_work_h *workh, re_async_h *cb, void *arg)
+{
+	return re_thread_async(&global_re, workh, cb, arg);
+}
+
+
 /**
  * Get the timer-list for this thread
  *
@@ -1259,3 +1853,17 @@ struct list *tmrl_get(void)
 {
 	return &re_get()->tmrl;
 }
+
+
+/**
+ * Get the timer-heap for this thread
+ *
+ * @return Pointer to timer heap
+ *
+ * @note only used by tmr module
+ */
+struct tmrh **tmrh_get(void);
+struct tmrh **tmrh_get(void)
+{
+	return &re_get()->tmrh;
+}
@@ -10,6 +10,20 @@ bool epoll_check(void);
 #endif
 
 
+#ifdef HAVE_IO_URING
+struct uring;
+
+bool uring_check(void);
+int  uring_alloc(struct uring **urp, unsigned entries);
+bool uring_multishot(const struct uring *ur);
+int  uring_poll_add(struct uring *ur, int fd, int flags, bool multi,
+		    uint64_t data);
+int  uring_poll_remove(struct uring *ur, uint64_t data, bool now);
+int  uring_wait(struct uring *ur, uint64_t to);
+bool uring_next(struct uring *ur, uint64_t *data, int32_t *res, bool *more);
+#endif
+
+
 #ifdef __cplusplus
 extern "C" {
 #endif
@@ -8,10 +8,18 @@ SRCS	+= main/init.c
 SRCS	+= main/main.c
 SRCS	+= main/method.c
 
+ifneq ($(HAVE_PTHREAD),)
+SRCS	+= main/pool.c
+endif
+
 ifneq ($(HAVE_EPOLL),)
 SRCS	+= main/epoll.c
 endif
 
+ifneq ($(HAVE_IO_URING),)
+SRCS	+= main/uring.c
+endif
+
 ifneq ($(USE_OPENSSL),)
 SRCS    += main/openssl.c
 endif
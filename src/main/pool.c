@@ -0,0 +1,227 @@
+/**
+ * @file pool.c  Pool of event loop worker threads
+ *
+ * Copyright (C) 2010 Creytiv.com
+ */
+#include <pthread.h>
+#include <re_types.h>
+#include <re_fmt.h>
+#include <re_mem.h>
+#include <re_mqueue.h>
+#include <re_main.h>
+
+
+#define DEBUG_MODULE "pool"
+#define DEBUG_LEVEL 5
+#include <re_dbg.h>
+
+
+/*
+ * Each worker thread runs its own re_main() loop. Sockets that are created
+ * from the start handler are polled by that worker only; with SO_REUSEPORT
+ * the kernel spreads the traffic for one address over all workers.
+ */
+
+
+enum {
+	POOL_MSG_STOP = 1
+};
+
+
+/** Defines a worker of the pool */
+struct re_worker {
+	struct re_pool *pool;  /**< Parent pool                     */
+	struct mqueue *mq;     /**< Message queue, NULL if stopped  */
+	pthread_t tid;         /**< Thread identifier               */
+	unsigned idx;          /**< Worker index                    */
+	bool started;          /**< Start handler has returned      */
+	int err;               /**< Start error                     */
+};
+
+/** Defines a pool of event loop threads */
+struct re_pool {
+	struct re_worker *wv;  /**< Vector of workers               */
+	unsigned n;            /**< Number of started threads       */
+	re_pool_start_h *starth;
+	re_pool_stop_h *stoph;
+	void *arg;
+	pthread_mutex_t mutex;
+	pthread_cond_t cond;
+};
+
+
+static void pool_destructor(void *data)
+{
+	struct re_pool *pool = data;
+	unsigned i;
+
+	pthread_mutex_lock(&pool->mutex);
+
+	for (i=0; i<pool->n; i++) {
+		struct re_worker *w = &pool->wv[i];
+
+		if (w->mq)
+			(void)mqueue_push(w->mq, POOL_MSG_STOP, NULL);
+	}
+
+	pthread_mutex_unlock(&pool->mutex);
+
+	for (i=0; i<pool->n; i++)
+		pthread_join(pool->wv[i].tid, NULL);
+
+	mem_deref(pool->wv);
+
+	pthread_cond_destroy(&pool->cond);
+	pthread_mutex_destroy(&pool->mutex);
+}
+
+
+static void mqueue_handler(int id, void *data, void *arg)
+{
+	(void)data;
+	(void)arg;
+
+	if (id == POOL_MSG_STOP)
+		re_cancel();
+}
+
+
+static void *worker_thread(void *arg)
+{
+	struct re_worker *w = arg;
+	struct re_pool *pool = w->pool;
+	struct mqueue *mq = NULL;
+	int err;
+
+	err = re_thread_init();
+	if (err)
+		goto out;
+
+	err = mqueue_alloc(&mq, mqueue_handler, w);
+	if (err)
+		goto out;
+
+	if (pool->starth)
+		err = pool->starth(w->idx, pool->arg);
+
+ out:
+	pthread_mutex_lock(&pool->mutex);
+	w->mq      = err ? NULL : mq;
+	w->err     = err;
+	w->started = true;
+	pthread_cond_broadcast(&pool->cond);
+	pthread_mutex_unlock(&pool->mutex);
+
+	if (!err) {
+		err = re_main(NULL);
+		if (err) {
+			DEBUG_WARNING("worker %u: re_main: %m\n", w->idx, err);
+		}
+
+		if (pool->stoph)
+			pool->stoph(w->idx, pool->arg);
+
+		pthread_mutex_lock(&pool->mutex);
+		w->mq = NULL;
+		pthread_mutex_unlock(&pool->mutex);
+	}
+
+	mem_deref(mq);
+	re_thread_close();
+
+	return NULL;
+}
+
+
+/**
+ * Allocate a pool of event loop threads. Every worker thread runs its own
+ * re_main() loop and calls the start handler from that thread, where the
+ * application can create per-worker sockets, e.g. with
+ * udp_listen_reuseport() or tcp_listen_reuseport() on the same address.
+ *
+ * @param poolp  Pointer to allocated pool
+ * @param n      Number of worker threads
+ * @param starth Start handler, called in each worker before polling
+ * @param stoph  Stop handler, called in each worker after polling
+ * @param arg    Handler argument
+ *
+ * @return 0 if success, otherwise errorcode
+ *
+ * @note The pool must not be destroyed from one of its worker threads
+ */
+int re_pool_alloc(struct re_pool **poolp, unsigned n,
+		  re_pool_start_h *starth, re_pool_stop_h *stoph, void *arg)
+{
+	struct re_pool *pool;
+	unsigned i;
+	int err = 0;
+
+	if (!poolp || !n)
+		return EINVAL;
+
+	pool = mem_zalloc(sizeof(*pool), pool_destructor);
+	if (!pool)
+		return ENOMEM;
+
+	pthread_mutex_init(&pool->mutex, NULL);
+	pthread_cond_init(&pool->cond, NULL);
+
+	pool->starth = starth;
+	pool->stoph  = stoph;
+	pool->arg    = arg;
+
+	pool->wv = mem_zalloc(n * sizeof(*pool->wv), NULL);
+	if (!pool->wv) {
+		err = ENOMEM;
+		goto out;
+	}
+
+	for (i=0; i<n; i++) {
+		struct re_worker *w = &pool->wv[i];
+
+		w->pool = pool;
+		w->idx  = i;
+
+		err = pthread_create(&w->tid, NULL, worker_thread, w);
+		if (err) {
+			DEBUG_WARNING("pthread_create: %m\n", err);
+			break;
+		}
+
+		++pool->n;
+	}
+
+	/* wait for all started workers to report */
+	pthread_mutex_lock(&pool->mutex);
+	for (i=0; i<pool->n; i++) {
+		struct re_worker *w = &pool->wv[i];
+
+		while (!w->started)
+			pthread_cond_wait(&pool->cond, &pool->mutex);
+
+		if (w->err && !err)
+			err = w->err;
+	}
+	pthread_mutex_unlock(&pool->mutex);
+
+ out:
+	if (err)
+		mem_deref(pool);
+	else
+		*poolp = pool;
+
+	return err;
+}
+
+
+/**
+ * Get the number of worker threads in a pool
+ *
+ * @param pool Pool of event loop threads
+ *
+ * @return Number of worker threads
+ */
+unsigned re_pool_count(const struct re_pool *pool)
+{
+	return pool ? pool->n : 0;
+}
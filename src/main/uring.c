@@ -0,0 +1,498 @@
+/**
+ * @file uring.c  io_uring specific routines
+ *
+ * Copyright (C) 2010 Creytiv.com
+ */
+#define _GNU_SOURCE 1
+#include <string.h>
+#include <unistd.h>
+#include <poll.h>
+#include <endian.h>
+#include <sys/mman.h>
+#include <sys/syscall.h>
+#include <linux/io_uring.h>
+#include <re_types.h>
+#include <re_mem.h>
+#include <re_mbuf.h>
+#include <re_main.h>
+#include "main.h"
+
+
+#define DEBUG_MODULE "uring"
+#define DEBUG_LEVEL 5
+#include <re_dbg.h>
+
+
+/*
+ * The rings are set up with the raw system calls, so there is no
+ * dependency on liburing. Submissions are queued in the shared ring and
+ * passed to the kernel together with the next wait, so one system call
+ * per loop iteration both submits and reaps.
+ *
+ * Only poll requests are used, the fd handlers do their own I/O. Where
+ * the kernel supports multishot poll (Linux 5.13), requests can stay
+ * armed over many completions instead of being re-armed after each one.
+ */
+
+
+enum {
+	URING_FEATURES = IORING_FEAT_NODROP | IORING_FEAT_EXT_ARG,
+};
+
+/** User data of the multishot probe, never a valid fd */
+static const uint64_t URING_PROBE = UINT64_MAX;
+
+
+/** Defines an io_uring instance */
+struct uring {
+	int fd;                      /**< Ring file descriptor           */
+
+	void *sq_ring;               /**< Mapped submission ring         */
+	size_t sq_ring_sz;           /**< Size of submission ring        */
+	unsigned *sq_head;           /**< Submission head (kernel)       */
+	unsigned *sq_tail;           /**< Submission tail (user)         */
+	unsigned sq_mask;            /**< Submission ring mask           */
+	unsigned sq_entries;         /**< Number of submission entries   */
+	unsigned *sq_array;          /**< Submission index array         */
+	struct io_uring_sqe *sqes;   /**< Mapped submission entries      */
+	size_t sqes_sz;              /**< Size of submission entries     */
+
+	void *cq_ring;               /**< Mapped completion ring         */
+	size_t cq_ring_sz;           /**< Size of completion ring        */
+	unsigned *cq_head;           /**< Completion head (user)         */
+	unsigned *cq_tail;           /**< Completion tail (kernel)       */
+	unsigned cq_mask;            /**< Completion ring mask           */
+	struct io_uring_cqe *cqes;   /**< Completion entries             */
+
+	bool multishot;              /**< Multishot poll is supported    */
+};
+
+
+static void multishot_probe(struct uring *ur);
+
+
+static int sys_setup(unsigned entries, struct io_uring_params *p)
+{
+	return (int)syscall(__NR_io_uring_setup, entries, p);
+}
+
+
+static int sys_enter(int fd, unsigned to_submit, unsigned min_complete,
+		     unsigned flags, void *arg, size_t argsz)
+{
+	return (int)syscall(__NR_io_uring_enter, fd, to_submit, min_complete,
+			    flags, arg, argsz);
+}
+
+
+static void destructor(void *arg)
+{
+	struct uring *ur = arg;
+
+	if (ur->sqes && ur->sqes != MAP_FAILED)
+		(void)munmap(ur->sqes, ur->sqes_sz);
+
+	if (ur->cq_ring && ur->cq_ring != MAP_FAILED &&
+	    ur->cq_ring != ur->sq_ring)
+		(void)munmap(ur->cq_ring, ur->cq_ring_sz);
+
+	if (ur->sq_ring && ur->sq_ring != MAP_FAILED)
+		(void)munmap(ur->sq_ring, ur->sq_ring_sz);
+
+	if (ur->fd >= 0)
+		(void)close(ur->fd);
+}
+
+
+/**
+ * Check for working io_uring kernel support, with the features that are
+ * needed for polling
+ *
+ * @return true if support, false if not
+ */
+bool uring_check(void)
+{
+	struct io_uring_params p;
+	int fd;
+
+	memset(&p, 0, sizeof(p));
+
+	fd = sys_setup(4, &p);
+	if (fd < 0) {
+		DEBUG_INFO("io_uring_setup: %m\n", errno);
+		return false;
+	}
+
+	(void)close(fd);
+
+	if ((p.features & URING_FEATURES) != URING_FEATURES) {
+		DEBUG_INFO("io_uring: missing features (0x%08x)\n",
+			   p.features);
+		return false;
+	}
+
+	return true;
+}
+
+
+/**
+ * Allocate an io_uring instance
+ *
+ * @param urp     Pointer to allocated io_uring
+ * @param entries Number of submission entries
+ *
+ * @return 0 if success, otherwise errorcode
+ */
+int uring_alloc(struct uring **urp, unsigned entries)
+{
+	struct io_uring_params p;
+	struct uring *ur;
+	int err = 0;
+
+	if (!urp || !entries)
+		return EINVAL;
+
+	ur = mem_zalloc(sizeof(*ur), destructor);
+	if (!ur)
+		return ENOMEM;
+
+	memset(&p, 0, sizeof(p));
+
+	ur->fd = sys_setup(entries, &p);
+	if (ur->fd < 0) {
+		err = errno;
+		DEBUG_WARNING("io_uring_setup: %m\n", err);
+		goto out;
+	}
+
+	ur->sq_ring_sz = p.sq_off.array + p.sq_entries * sizeof(unsigned);
+	ur->cq_ring_sz = p.cq_off.cqes +
+		p.cq_entries * sizeof(struct io_uring_cqe);
+
+	if (p.features & IORING_FEAT_SINGLE_MMAP)
+		ur->sq_ring_sz = ur->cq_ring_sz =
+			max(ur->sq_ring_sz, ur->cq_ring_sz);
+
+	ur->sq_ring = mmap(NULL, ur->sq_ring_sz, PROT_READ | PROT_WRITE,
+			   MAP_SHARED | MAP_POPULATE, ur->fd,
+			   IORING_OFF_SQ_RING);
+	if (ur->sq_ring == MAP_FAILED) {
+		err = errno;
+		goto out;
+	}
+
+	if (p.features & IORING_FEAT_SINGLE_MMAP) {
+		ur->cq_ring = ur->sq_ring;
+	}
+	else {
+		ur->cq_ring = mmap(NULL, ur->cq_ring_sz,
+				   PROT_READ | PROT_WRITE,
+				   MAP_SHARED | MAP_POPULATE, ur->fd,
+				   IORING_OFF_CQ_RING);
+		if (ur->cq_ring == MAP_FAILED) {
+			err = errno;
+			goto out;
+		}
+	}
+
+	ur->sqes_sz = p.sq_entries * sizeof(struct io_uring_sqe);
+	ur->sqes = mmap(NULL, ur->sqes_sz, PROT_READ | PROT_WRITE,
+			MAP_SHARED | MAP_POPULATE, ur->fd, IORING_OFF_SQES);
+	if (ur->sqes == MAP_FAILED) {
+		err = errno;
+		goto out;
+	}
+
+	ur->sq_head    = (unsigned *)((char *)ur->sq_ring + p.sq_off.head);
+	ur->sq_tail    = (unsigned *)((char *)ur->sq_ring + p.sq_off.tail);
+	ur->sq_mask    = *(unsigned *)((char *)ur->sq_ring +
+				       p.sq_off.ring_mask);
+	ur->sq_array   = (unsigned *)((char *)ur->sq_ring + p.sq_off.array);
+	ur->sq_entries = p.sq_entries;
+
+	ur->cq_head = (unsigned *)((char *)ur->cq_ring + p.cq_off.head);
+	ur->cq_tail = (unsigned *)((char *)ur->cq_ring + p.cq_off.tail);
+	ur->cq_mask = *(unsigned *)((char *)ur->cq_ring + p.cq_off.ring_mask);
+	ur->cqes    = (struct io_uring_cqe *)((char *)ur->cq_ring +
+					      p.cq_off.cqes);
+
+	multishot_probe(ur);
+
+ out:
+	if (err)
+		mem_deref(ur);
+	else
+		*urp = ur;
+
+	return err;
+}
+
+
+/* Number of queued submissions, not yet consumed by the kernel */
+static unsigned sq_pending(const struct uring *ur)
+{
+	return __atomic_load_n(ur->sq_tail, __ATOMIC_ACQUIRE) -
+		__atomic_load_n(ur->sq_head, __ATOMIC_ACQUIRE);
+}
+
+
+/* Pass all queued submissions to the kernel */
+static int submit(struct uring *ur)
+{
+	unsigned n;
+
+	while ((n = sq_pending(ur)) != 0) {
+
+		if (sys_enter(ur->fd, n, 0, 0, NULL, 0) < 0) {
+			if (EINTR == errno)
+				continue;
+
+			return errno;
+		}
+	}
+
+	return 0;
+}
+
+
+static struct io_uring_sqe *sqe_get(struct uring *ur)
+{
+	const unsigned tail = *ur->sq_tail;
+	const unsigned head = __atomic_load_n(ur->sq_head, __ATOMIC_ACQUIRE);
+	struct io_uring_sqe *sqe;
+
+	if (tail - head >= ur->sq_entries) {
+
+		if (submit(ur))
+			return NULL;
+
+		return sqe_get(ur);
+	}
+
+	sqe = &ur->sqes[tail & ur->sq_mask];
+	memset(sqe, 0, sizeof(*sqe));
+
+	return sqe;
+}
+
+
+static void sqe_push(struct uring *ur)
+{
+	const unsigned tail = *ur->sq_tail;
+
+	ur->sq_array[tail & ur->sq_mask] = tail & ur->sq_mask;
+
+	__atomic_store_n(ur->sq_tail, tail + 1, __ATOMIC_RELEASE);
+}
+
+
+static int poll_add(struct uring *ur, int fd, uint32_t events, bool multi,
+		    uint64_t data)
+{
+	struct io_uring_sqe *sqe;
+
+#if __BYTE_ORDER == __BIG_ENDIAN
+	events = (events << 16) | (events >> 16);
+#endif
+
+	sqe = sqe_get(ur);
+	if (!sqe)
+		return ENOSPC;
+
+	sqe->opcode        = IORING_OP_POLL_ADD;
+	sqe->fd            = fd;
+	sqe->poll32_events = events;
+	sqe->len           = multi ? IORING_POLL_ADD_MULTI : 0;
+	sqe->user_data     = data;
+
+	sqe_push(ur);
+
+	return 0;
+}
+
+
+/*
+ * Older kernels reject the multishot flag with EINVAL. The probe polls a
+ * readable pipe and checks that the completion announces more to come.
+ * Completions of the probe that are still pending are ignored by the
+ * caller, as the user data does not map to an fd.
+ */
+static void multishot_probe(struct uring *ur)
+{
+	const struct io_uring_cqe *cqe;
+	int pfd[2];
+	unsigned head;
+
+	if (pipe(pfd))
+		return;
+
+	if (write(pfd[1], "", 1) != 1)
+		goto out;
+
+	if (poll_add(ur, pfd[0], POLLIN, true, URING_PROBE))
+		goto out;
+
+	if (sys_enter(ur->fd, sq_pending(ur), 1, IORING_ENTER_GETEVENTS,
+		      NULL, 0) < 0)
+		goto out;
+
+	head = *ur->cq_head;
+	if (head == __atomic_load_n(ur->cq_tail, __ATOMIC_ACQUIRE))
+		goto out;
+
+	cqe = &ur->cqes[head & ur->cq_mask];
+	if (cqe->user_data != URING_PROBE)
+		goto out;
+
+	ur->multishot = cqe->res > 0 && (cqe->flags & IORING_CQE_F_MORE);
+
+	__atomic_store_n(ur->cq_head, head + 1, __ATOMIC_RELEASE);
+
+	if (ur->multishot)
+		(void)uring_poll_remove(ur, URING_PROBE, true);
+
+ out:
+	(void)close(pfd[0]);
+	(void)close(pfd[1]);
+
+	DEBUG_INFO("multishot poll: %s\n", ur->multishot ? "yes" : "no");
+}
+
+
+/**
+ * Check if poll requests can be multishot
+ *
+ * @param ur io_uring instance
+ *
+ * @return true if supported, otherwise false
+ */
+bool uring_multishot(const struct uring *ur)
+{
+	return ur ? ur->multishot : false;
+}
+
+
+/**
+ * Queue a poll request for a file descriptor
+ *
+ * @param ur    io_uring instance
+ * @param fd    File descriptor
+ * @param flags Wanted event flags
+ * @param multi True for a multishot request, see uring_multishot()
+ * @param data  User data of the completions
+ *
+ * @return 0 if success, otherwise errorcode
+ */
+int uring_poll_add(struct uring *ur, int fd, int flags, bool multi,
+		   uint64_t data)
+{
+	uint32_t events = 0;
+
+	if (!ur)
+		return EINVAL;
+
+	if (flags & FD_READ)
+		events |= POLLIN;
+	if (flags & FD_WRITE)
+		events |= POLLOUT;
+	if (flags & FD_EXCEPT)
+		events |= POLLERR;
+
+	return poll_add(ur, fd, events, multi && ur->multishot, data);
+}
+
+
+/**
+ * Cancel a poll request
+ *
+ * @param ur   io_uring instance
+ * @param data User data of the poll request
+ * @param now  True to submit the request now
+ *
+ * @return 0 if success, otherwise errorcode
+ */
+int uring_poll_remove(struct uring *ur, uint64_t data, bool now)
+{
+	struct io_uring_sqe *sqe;
+
+	if (!ur)
+		return EINVAL;
+
+	sqe = sqe_get(ur);
+	if (!sqe)
+		return ENOSPC;
+
+	sqe->opcode    = IORING_OP_POLL_REMOVE;
+	sqe->fd        = -1;
+	sqe->addr      = data;
+	sqe->user_data = 0;
+
+	sqe_push(ur);
+
+	return now ? submit(ur) : 0;
+}
+
+
+/**
+ * Submit queued requests and wait for at least one completion
+ *
+ * @param ur io_uring instance
+ * @param to Timeout in [ms], 0 to wait forever
+ *
+ * @return 0 if success, otherwise errorcode
+ */
+int uring_wait(struct uring *ur, uint64_t to)
+{
+	struct io_uring_getevents_arg arg;
+	struct __kernel_timespec ts;
+	int r;
+
+	if (!ur)
+		return EINVAL;
+
+	memset(&arg, 0, sizeof(arg));
+
+	if (to) {
+		ts.tv_sec  = (int64_t)(to / 1000);
+		ts.tv_nsec = (long long)(to % 1000) * 1000000;
+		arg.ts = (uint64_t)(uintptr_t)&ts;
+	}
+
+	r = sys_enter(ur->fd, sq_pending(ur), 1,
+		      IORING_ENTER_GETEVENTS | IORING_ENTER_EXT_ARG,
+		      &arg, sizeof(arg));
+	if (r < 0 && ETIME != errno)
+		return errno;
+
+	return 0;
+}
+
+
+/**
+ * Get the next completion
+ *
+ * @param ur   io_uring instance
+ * @param data Returned user data
+ * @param res  Returned result
+ * @param more Returned true if the request stays armed
+ *
+ * @return true if a completion was returned, false if none are pending
+ */
+bool uring_next(struct uring *ur, uint64_t *data, int32_t *res, bool *more)
+{
+	const unsigned head = *ur->cq_head;
+	const struct io_uring_cqe *cqe;
+
+	if (head == __atomic_load_n(ur->cq_tail, __ATOMIC_ACQUIRE))
+		return false;
+
+	cqe = &ur->cqes[head & ur->cq_mask];
+
+	*data = cqe->user_data;
+	*res  = cqe->res;
+	*more = (cqe->flags & IORING_CQE_F_MORE) != 0;
+
+	__atomic_store_n(ur->cq_head, head + 1, __ATOMIC_RELEASE);
+
+	return true;
+}
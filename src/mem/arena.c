@@ -0,0 +1,164 @@
+/**
+ * @file arena.c  Memory arena for objects with a common lifetime
+ *
+ * Copyright (C) 2010 Creytiv.com
+ */
+#include <string.h>
+#include <re_types.h>
+#include <re_mem.h>
+
+
+/*
+ * Objects are bump-allocated from a buffer that is allocated together with
+ * the arena. If the buffer is exhausted, more chunks are added. Objects can
+ * not be freed individually, they are all released with the arena.
+ */
+
+
+enum {
+	ARENA_ALIGN = 2 * sizeof(void *),
+};
+
+#define ALIGN_UP(x) (((x) + ARENA_ALIGN - 1) & ~(uintptr_t)(ARENA_ALIGN - 1))
+
+
+/** Defines an additional memory chunk */
+struct arena_chunk {
+	struct arena_chunk *next;  /**< Next chunk     */
+};
+
+/** Defines the header of an arena object with a destructor */
+struct arena_obj {
+	struct arena_obj *next;    /**< Next object    */
+	mem_destroy_h *dh;         /**< Destructor     */
+};
+
+/** Defines a memory arena */
+struct mem_arena {
+	struct arena_chunk *chunkl;  /**< Additional chunks, newest first  */
+	struct arena_obj *objl;      /**< Objects with destructor          */
+	uintptr_t pos;               /**< Next free byte                   */
+	uintptr_t end;               /**< End of current chunk             */
+	size_t size;                 /**< Size of the initial buffer       */
+};
+
+
+static void destructor(void *arg)
+{
+	struct mem_arena *arena = arg;
+	struct arena_obj *obj = arena->objl;
+	struct arena_chunk *chunk = arena->chunkl;
+
+	/* newest object first */
+	while (obj) {
+		obj->dh(obj + 1);
+		obj = obj->next;
+	}
+
+	while (chunk) {
+		struct arena_chunk *next = chunk->next;
+
+		mem_deref(chunk);
+		chunk = next;
+	}
+}
+
+
+static void *bump(struct mem_arena *arena, size_t size)
+{
+	struct arena_chunk *chunk;
+	uintptr_t p = ALIGN_UP(arena->pos);
+	size_t sz;
+
+	if (p <= arena->end && size <= arena->end - p) {
+		arena->pos = p + size;
+		return (void *)p;
+	}
+
+	sz = max(arena->size, size) + ARENA_ALIGN;
+
+	chunk = mem_alloc(sizeof(*chunk) + sz, NULL);
+	if (!chunk)
+		return NULL;
+
+	chunk->next   = arena->chunkl;
+	arena->chunkl = chunk;
+
+	p = ALIGN_UP((uintptr_t)(chunk + 1));
+	arena->end = (uintptr_t)(chunk + 1) + sz;
+	arena->pos = p + size;
+
+	return (void *)p;
+}
+
+
+/**
+ * Allocate a new memory arena
+ *
+ * @param arenap Pointer to allocated memory arena
+ * @param size   Size of the initial buffer in bytes
+ *
+ * @return 0 if success, otherwise errorcode
+ */
+int mem_arena_alloc(struct mem_arena **arenap, size_t size)
+{
+	struct mem_arena *arena;
+
+	if (!arenap)
+		return EINVAL;
+
+	arena = mem_alloc(sizeof(*arena) + size + ARENA_ALIGN, destructor);
+	if (!arena)
+		return ENOMEM;
+
+	arena->chunkl = NULL;
+	arena->objl   = NULL;
+	arena->pos    = (uintptr_t)(arena + 1);
+	arena->end    = arena->pos + size + ARENA_ALIGN;
+	arena->size   = size;
+
+	*arenap = arena;
+
+	return 0;
+}
+
+
+/**
+ * Allocate a zeroed object from a memory arena. The object is valid until
+ * the arena is destroyed, and must not be passed to mem_deref()
+ *
+ * @param arena Memory arena
+ * @param size  Size of object
+ * @param dh    Optional destructor, called when the arena is destroyed
+ *
+ * @return Pointer to allocated object, NULL if no memory
+ */
+void *mem_arena_zalloc(struct mem_arena *arena, size_t size,
+		       mem_destroy_h *dh)
+{
+	struct arena_obj *obj;
+	void *p;
+
+	if (!arena)
+		return NULL;
+
+	if (!dh) {
+		p = bump(arena, size);
+		if (p)
+			memset(p, 0, size);
+
+		return p;
+	}
+
+	obj = bump(arena, sizeof(*obj) + size);
+	if (!obj)
+		return NULL;
+
+	memset(obj + 1, 0, size);
+
+	obj->dh     = dh;
+	obj->next   = arena->objl;
+	arena->objl = obj;
+
+	return obj + 1;
+}
@@ -4,11 +4,19 @@
  * Copyright (C) 2010 Creytiv.com
  */
 #include <ctype.h>
+#include <stddef.h>
 #include <stdlib.h>
 #include <string.h>
 #ifdef HAVE_PTHREAD
 #include <pthread.h>
 #endif
+#if defined(HAVE_ATOMIC) && !defined(__STDC_NO_ATOMICS__)
+#include <stdatomic.h>
+#define MEM_STAT_ATOMIC 1  /**< Atomic slab counters */
+#ifdef RE_MEM_ATOMIC
+#define MEM_ATOMIC 1       /**< Atomic reference counting */
+#endif
+#endif
 #include <re_types.h>
 #include <re_list.h>
 #include <re_fmt.h>
@@ -26,9 +34,25 @@
 #endif
 
 
+/*
+ * The object header must keep the user data aligned for any type, also on
+ * ILP32 targets where the slab class does not fit into padding.
+ */
+#if defined(__STDC_VERSION__) && __STDC_VERSION__ >= 201112L
+#define MEM_ALIGN _Alignas(max_align_t)
+#else
+#define MEM_ALIGN
+#endif
+
+
 /** Defines a reference-counting memory object */
 struct mem {
-	uint32_t nrefs;     /**< Number of references  */
+#ifdef MEM_ATOMIC
+	MEM_ALIGN _Atomic uint32_t nrefs;  /**< Number of references  */
+#else
+	MEM_ALIGN uint32_t nrefs;  /**< Number of references  */
+#endif
+	uint32_t cls;       /**< Slab size class, 0 for malloc */
 	mem_destroy_h *dh;  /**< Destroy handler       */
 #if MEM_DEBUG
 	struct le le;       /**< Linked list element   */
@@ -37,6 +61,30 @@ struct mem {
 #endif
 };
 
+/*
+ * When built with RE_MEM_ATOMIC and C11 atomics, the reference count can be
+ * changed from several threads, so objects such as mbufs can be shared
+ * between event loops without locking. Taking a reference needs no
+ * ordering, dropping one must order all prior accesses before the
+ * destructor runs. This is off by default, as every reference change then
+ * becomes a locked instruction.
+ */
+#ifdef MEM_ATOMIC
+#define NREFS_INIT(m, n)  atomic_init(&(m)->nrefs, (n))
+#define NREFS_GET(m)      atomic_load_explicit(&(m)->nrefs, \
+					       memory_order_acquire)
+#define NREFS_INC(m)      atomic_fetch_add_explicit(&(m)->nrefs, 1, \
+						    memory_order_relaxed)
+#define NREFS_DEC(m)      (atomic_fetch_sub_explicit(&(m)->nrefs, 1, \
+				memory_order_acq_rel) - 1)
+#else
+#define NREFS_INIT(m, n)  ((m)->nrefs = (n))
+#define NREFS_GET(m)      ((m)->nrefs)
+#define NREFS_INC(m)      (++(m)->nrefs)
+#define NREFS_DEC(m)      (--(m)->nrefs)
+#endif
+
+
 #if MEM_DEBUG
 /* Memory debugging */
 static struct list meml = LIST_INIT;
@@ -44,7 +92,7 @@ static const uint32_t mem_magic = 0xe7fb9ac4;
 static ssize_t threshold = -1;  /**< Memory threshold, disabled by default */
 
 static struct memstat memstat = {
-	0,0,0,0,~0,0
+	0,0,0,0,~0,0,0,0,0
 };
 
 #ifdef HAVE_PTHREAD
@@ -115,6 +163,215 @@ static inline void mem_unlock(void)
 #endif
 
 
+/*
+ * Slab statistics are kept in release builds too. Without C11 atomics the
+ * counters are not synchronized and only approximate with several threads.
+ */
+static struct {
+#ifdef MEM_STAT_ATOMIC
+	_Atomic size_t slab_hits;
+	_Atomic size_t slab_misses;
+	_Atomic size_t slab_cached;
+#else
+	size_t slab_hits;
+	size_t slab_misses;
+	size_t slab_cached;
+#endif
+} slabstat;
+
+#ifdef MEM_STAT_ATOMIC
+#define STAT_SLAB(field, n) \
+	atomic_fetch_add_explicit(&slabstat.field, (size_t)(n), \
+				  memory_order_relaxed)
+#define SLAB_GET(field) \
+	atomic_load_explicit(&slabstat.field, memory_order_relaxed)
+#else
+#define STAT_SLAB(field, n) (slabstat.field += (size_t)(n))
+#define SLAB_GET(field)     (slabstat.field)
+#endif
+
+
+/*
+ * Slab backend (optional): freed blocks of small objects are kept in
+ * per-thread free lists per size class, and are reused by the next
+ * allocation of the same class without calling malloc() and free().
+ * Each block carries its size class, so it can be freed in any thread.
+ */
+
+enum {
+	MEM_CACHE_MAX = 128,  /**< Max free blocks per class and thread */
+};
+
+/** Block sizes of the slab classes, including the object header */
+static const size_t mem_classv[] = {
+	0, 32, 48, 64, 96, 128, 192, 256, 384, 512, 768, 1024, 1536, 2048
+};
+
+#define MEM_NCLASS ARRAY_SIZE(mem_classv)
+
+/** Per-thread cache of free blocks */
+struct mem_cache {
+	void *freel[MEM_NCLASS];     /**< Free list per size class     */
+	uint32_t nfree[MEM_NCLASS];  /**< Number of free blocks        */
+};
+
+static enum mem_backend mem_backend = MEM_BACKEND_MALLOC;
+
+
+static void cache_flush(struct mem_cache *c)
+{
+	size_t cls, n = 0;
+
+	for (cls=1; cls<MEM_NCLASS; cls++) {
+
+		while (c->freel[cls]) {
+			void *b = c->freel[cls];
+
+			c->freel[cls] = *(void **)b;
+			free(b);
+			++n;
+		}
+
+		c->nfree[cls] = 0;
+	}
+
+	STAT_SLAB(slab_cached, -n);
+}
+
+
+#ifdef HAVE_PTHREAD
+
+static pthread_once_t cache_once = PTHREAD_ONCE_INIT;
+static pthread_key_t  cache_key;
+
+
+static void cache_destructor(void *arg)
+{
+	cache_flush(arg);
+	free(arg);
+}
+
+
+static void cache_init(void)
+{
+	pthread_key_create(&cache_key, cache_destructor);
+}
+
+
+static struct mem_cache *cache_get(void)
+{
+	struct mem_cache *c;
+
+	pthread_once(&cache_once, cache_init);
+
+	c = pthread_getspecific(cache_key);
+	if (!c) {
+		c = calloc(1, sizeof(*c));
+		if (c)
+			pthread_setspecific(cache_key, c);
+	}
+
+	return c;
+}
+
+#else
+
+static struct mem_cache *cache_get(void)
+{
+	static struct mem_cache cache;
+
+	return &cache;
+}
+
+#endif
+
+
+static struct mem *block_alloc(size_t size)
+{
+	const size_t total = sizeof(struct mem) + size;
+	struct mem_cache *c;
+	struct mem *m;
+	uint32_t cls;
+
+	if (mem_backend != MEM_BACKEND_SLAB ||
+	    total > mem_classv[MEM_NCLASS - 1]) {
+
+		m = malloc(total);
+		if (m)
+			m->cls = 0;
+
+		return m;
+	}
+
+	for (cls=1; mem_classv[cls] < total; cls++)
+		;
+
+	c = cache_get();
+	if (c && c->freel[cls]) {
+		m = c->freel[cls];
+		c->freel[cls] = *(void **)m;
+		--c->nfree[cls];
+
+		STAT_SLAB(slab_hits, 1);
+		STAT_SLAB(slab_cached, -1);
+	}
+	else {
+		m = malloc(mem_classv[cls]);
+		if (!m)
+			return NULL;
+
+		STAT_SLAB(slab_misses, 1);
+	}
+
+	m->cls = cls;
+
+	return m;
+}
+
+
+static void block_free(struct mem *m, uint32_t cls)
+{
+	struct mem_cache *c;
+
+	if (cls) {
+		c = cache_get();
+		if (c && c->nfree[cls] < MEM_CACHE_MAX) {
+			*(void **)m = c->freel[cls];
+			c->freel[cls] = m;
+			++c->nfree[cls];
+
+			STAT_SLAB(slab_cached, 1);
+			return;
+		}
+	}
+
+	free(m);
+}
+
+
+static struct mem *block_realloc(struct mem *m, size_t size)
+{
+	const size_t cap = mem_classv[m->cls];
+	struct mem *m2;
+	uint32_t cls;
+
+	if (sizeof(*m) + size <= cap)
+		return m;
+
+	m2 = block_alloc(size);
+	if (!m2)
+		return NULL;
+
+	cls = m2->cls;
+	memcpy(m2, m, cap);
+	m2->cls = cls;
+
+	block_free(m, m->cls);
+
+	return m2;
+}
+
+
 /**
  * Allocate a new reference-counted memory object
  *
@@ -136,7 +393,7 @@ void *mem_alloc(size_t size, mem_destroy_h *dh)
 	mem_unlock();
 #endif
 
-	m = malloc(sizeof(*m) + size);
+	m = block_alloc(size);
 	if (!m)
 		return NULL;
 
@@ -147,7 +404,7 @@ void *mem_alloc(size_t size, mem_destroy_h *dh)
 	mem_unlock();
 #endif
 
-	m->nrefs = 1;
+	NREFS_INIT(m, 1);
 	m->dh    = dh;
 
 	STAT_ALLOC(m, size);
@@ -214,7 +471,10 @@ void *mem_realloc(void *data, size_t size)
 	mem_unlock();
 #endif
 
-	m2 = realloc(m, sizeof(*m2) + size);
+	if (m->cls)
+		m2 = block_realloc(m, size);
+	else
+		m2 = realloc(m, sizeof(*m2) + size);
 
 #if MEM_DEBUG
 	mem_lock();
@@ -273,6 +533,11 @@ void *mem_reallocarray(void *ptr, size_t nmemb, size_t membsize,
  * @param data Memory object
  *
  * @return Memory object (same as data)
+ *
+ * @note The reference count is atomic if built with RE_MEM_ATOMIC
+ *       (USE_MEM_ATOMIC=1) and a compiler with C11 atomics, then
+ *       references may be taken and dropped from any thread. Otherwise
+ *       the option is ignored and the count is not thread-safe
  */
 void *mem_ref(void *data)
 {
@@ -285,7 +550,7 @@ void *mem_ref(void *data)
 
 	MAGIC_CHECK(m);
 
-	++m->nrefs;
+	(void)NREFS_INC(m);
 
 	return data;
 }
@@ -303,6 +568,7 @@ void *mem_ref(void *data)
 void *mem_deref(void *data)
 {
 	struct mem *m;
+	uint32_t cls;
 
 	if (!data)
 		return NULL;
@@ -311,14 +577,14 @@ void *mem_deref(void *data)
 
 	MAGIC_CHECK(m);
 
-	if (--m->nrefs > 0)
+	if (NREFS_DEC(m) > 0)
 		return NULL;
 
 	if (m->dh)
 		m->dh(data);
 
 	/* NOTE: check if the destructor called mem_ref() */
-	if (m->nrefs > 0)
+	if (NREFS_GET(m) > 0)
 		return NULL;
 
 #if MEM_DEBUG
@@ -327,9 +593,12 @@ void *mem_deref(void *data)
 	mem_unlock();
 #endif
 
+	/* NOTE: read before the debug poisoning of the header */
+	cls = m->cls;
+
 	STAT_DEREF(m);
 
-	free(m);
+	block_free(m, cls);
 
 	return NULL;
 }
@@ -353,7 +622,7 @@ uint32_t mem_nrefs(const void *data)
 
 	MAGIC_CHECK(m);
 
-	return m->nrefs;
+	return NREFS_GET(m);
 }
 
 
@@ -366,7 +635,7 @@ static bool debug_handler(struct le *le, void *arg)
 
 	(void)arg;
 
-	(void)re_fprintf(stderr, "  %p: nrefs=%-2u", p, m->nrefs);
+	(void)re_fprintf(stderr, "  %p: nrefs=%-2u", p, NREFS_GET(m));
 
 	(void)re_fprintf(stderr, " size=%-7u", m->size);
 
@@ -442,6 +711,31 @@ void mem_threshold_set(ssize_t n)
 }
 
 
+/**
+ * Set the memory allocator backend. The slab backend keeps freed small
+ * objects in per-thread free lists for reuse. It should be selected once
+ * at startup, before libre_init(), but blocks from either backend can be
+ * freed after switching.
+ *
+ * @param backend Memory allocator backend
+ *
+ * @return 0 if success, otherwise errorcode
+ */
+int mem_backend_set(enum mem_backend backend)
+{
+	switch (backend) {
+
+	case MEM_BACKEND_MALLOC:
+	case MEM_BACKEND_SLAB:
+		mem_backend = backend;
+		return 0;
+
+	default:
+		return EINVAL;
+	}
+}
+
+
 /**
  * Print memory status
  *
@@ -477,13 +771,19 @@ int mem_status(struct re_printf *pf, void *unused)
 	err |= re_hprintf(pf, " Block size: min=%u, max=%u\n",
 			  stat.size_min, stat.size_max);
 	err |= re_hprintf(pf, " Total %u blocks allocated\n", c);
-
-	return err;
 #else
-	(void)pf;
+	int err = 0;
+
 	(void)unused;
-	return 0;
 #endif
+	if (mem_backend == MEM_BACKEND_SLAB) {
+		err |= re_hprintf(pf, " Slab: hits=%zu misses=%zu"
+				  " cached=%zu blocks\n",
+				  SLAB_GET(slab_hits), SLAB_GET(slab_misses),
+				  SLAB_GET(slab_cached));
+	}
+
+	return err;
 }
 
 
@@ -492,7 +792,7 @@ int mem_status(struct re_printf *pf, void *unused)
  *
  * @param mstat Returned memory statistics
  *
- * @return 0 if success, otherwise errorcode
+ * @return 0 if success, ENOSYS in release builds, otherwise errorcode
  */
 int mem_get_stat(struct memstat *mstat)
 {
@@ -502,8 +802,29 @@ int mem_get_stat(struct memstat *mstat)
 	mem_lock();
 	memcpy(mstat, &memstat, sizeof(*mstat));
 	mem_unlock();
+	mstat->slab_hits   = SLAB_GET(slab_hits);
+	mstat->slab_misses = SLAB_GET(slab_misses);
+	mstat->slab_cached = SLAB_GET(slab_cached);
 	return 0;
 #else
 	return ENOSYS;
 #endif
 }
+
+
+/**
+ * Get the counters of the slab backend, also available in release builds
+ *
+ * @param hits   Returned number of allocations from slab caches (optional)
+ * @param misses Returned number of slab allocations from malloc (optional)
+ * @param cached Returned number of free blocks in slab caches (optional)
+ */
+void mem_slab_stats(size_t *hits, size_t *misses, size_t *cached)
+{
+	if (hits)
+		*hits = SLAB_GET(slab_hits);
+	if (misses)
+		*misses = SLAB_GET(slab_misses);
+	if (cached)
+		*cached = SLAB_GET(slab_cached);
+}
@@ -4,5 +4,6 @@
 # Copyright (C) 2010 Creytiv.com
 #
 
+SRCS	+= mem/arena.c
 SRCS	+= mem/mem.c
 SRCS	+= mem/secure.c
@@ -6,6 +6,14 @@
 #ifdef HAVE_UNISTD_H
 #include <unistd.h>
 #endif
+#if defined(HAVE_ATOMIC) && !defined(__STDC_NO_ATOMICS__)
+#include <stdatomic.h>
+#define MQUEUE_RING 1
+#endif
+#if defined(MQUEUE_RING) && defined(LINUX)
+#include <sys/eventfd.h>
+#define MQUEUE_EVENTFD 1
+#endif
 #include <re_types.h>
 #include <re_fmt.h>
 #include <re_mem.h>
@@ -25,6 +33,33 @@
 #endif
 
 
+#ifdef MQUEUE_RING
+/*
+ * Messages are passed in a bounded lock-free multi-producer single-consumer
+ * ring. The file descriptor is only used as a doorbell, which is rung on the
+ * transition from idle to pending, and the receiving thread drains all
+ * pending messages per wakeup.
+ */
+
+enum {
+	MQUEUE_SIZE = 4096,  /* same capacity as a 64K pipe of messages */
+	MQUEUE_MASK = MQUEUE_SIZE - 1,
+};
+
+struct slot {
+	atomic_size_t seq;
+	void *data;
+	int id;
+};
+#else
+struct msg {
+	void *data;
+	uint32_t magic;
+	int id;
+};
+#endif
+
+
 /**
  * Defines a Thread-safe Message Queue
  *
@@ -36,12 +71,12 @@ struct mqueue {
 	int pfd[2];
 	mqueue_h *h;
 	void *arg;
-};
-
-struct msg {
-	void *data;
-	uint32_t magic;
-	int id;
+#ifdef MQUEUE_RING
+	struct slot *slotv;
+	atomic_size_t head;     /**< Next slot to write (producers) */
+	size_t tail;            /**< Next slot to read (consumer)   */
+	atomic_bool signalled;  /**< Doorbell has been rung         */
+#endif
 };
 
 
@@ -53,11 +88,96 @@ static void destructor(void *arg)
 		fd_close(q->pfd[0]);
 		(void)close(q->pfd[0]);
 	}
-	if (q->pfd[1] >= 0)
+	if (q->pfd[1] >= 0 && q->pfd[1] != q->pfd[0])
 		(void)close(q->pfd[1]);
+
+#ifdef MQUEUE_RING
+	mem_deref(q->slotv);
+#endif
+}
+
+
+#ifdef MQUEUE_RING
+static void doorbell_clear(struct mqueue *mq)
+{
+#ifdef MQUEUE_EVENTFD
+	uint64_t cnt;
+
+	(void)pipe_read(mq->pfd[0], &cnt, sizeof(cnt));
+#else
+	uint8_t buf[64];
+
+	while (pipe_read(mq->pfd[0], buf, sizeof(buf)) == sizeof(buf))
+		;
+#endif
+}
+
+
+static int doorbell_ring(struct mqueue *mq)
+{
+#ifdef MQUEUE_EVENTFD
+	const uint64_t cnt = 1;
+#else
+	const uint8_t cnt = 1;
+#endif
+	ssize_t n;
+
+	n = pipe_write(mq->pfd[1], &cnt, sizeof(cnt));
+	if (n < 0)
+		return errno;
+
+	return (n != sizeof(cnt)) ? EPIPE : 0;
+}
+
+
+static bool ring_pop(struct mqueue *mq, int *id, void **data)
+{
+	struct slot *s = &mq->slotv[mq->tail & MQUEUE_MASK];
+	size_t seq;
+
+	seq = atomic_load_explicit(&s->seq, memory_order_acquire);
+	if (seq != mq->tail + 1)
+		return false;
+
+	*id   = s->id;
+	*data = s->data;
+
+	atomic_store_explicit(&s->seq, mq->tail + MQUEUE_SIZE,
+			      memory_order_release);
+	++mq->tail;
+
+	return true;
 }
 
 
+static void event_handler(int flags, void *arg)
+{
+	struct mqueue *mq = arg;
+	void *data;
+	int id;
+
+	if (!(flags & FD_READ))
+		return;
+
+	doorbell_clear(mq);
+
+	/* producers that push from now on must ring the doorbell again */
+	(void)atomic_exchange(&mq->signalled, false);
+
+	mem_ref(mq);
+
+	while (ring_pop(mq, &id, &data)) {
+
+		mq->h(id, data, mq->arg);
+
+		/* message handler closed the queue */
+		if (mem_nrefs(mq) == 1)
+			break;
+	}
+
+	mem_deref(mq);
+}
+#else
 static void event_handler(int flags, void *arg)
 {
 	struct mqueue *mq = arg;
@@ -85,6 +205,36 @@ static void event_handler(int flags, void *arg)
 
 	mq->h(msg.id, msg.data, mq->arg);
 }
+#endif
+
+
+static int doorbell_alloc(struct mqueue *mq)
+{
+#ifdef MQUEUE_EVENTFD
+	mq->pfd[0] = eventfd(0, EFD_NONBLOCK | EFD_CLOEXEC);
+	if (mq->pfd[0] < 0)
+		return errno;
+
+	mq->pfd[1] = mq->pfd[0];
+
+	return 0;
+#else
+	int err;
+
+	if (pipe(mq->pfd) < 0)
+		return errno;
+
+	err = net_sockopt_blocking_set(mq->pfd[0], false);
+	if (err)
+		return err;
+
+	err = net_sockopt_blocking_set(mq->pfd[1], false);
+	if (err)
+		return err;
+
+	return 0;
+#endif
+}
 
 
 /**
@@ -99,6 +249,9 @@ static void event_handler(int flags, void *arg)
 int mqueue_alloc(struct mqueue **mqp, mqueue_h *h, void *arg)
 {
 	struct mqueue *mq;
+#ifdef MQUEUE_RING
+	size_t i;
+#endif
 	int err = 0;
 
 	if (!mqp || !h)
@@ -112,16 +265,22 @@ int mqueue_alloc(struct mqueue **mqp, mqueue_h *h, void *arg)
 	mq->arg = arg;
 
 	mq->pfd[0] = mq->pfd[1] = -1;
-	if (pipe(mq->pfd) < 0) {
-		err = errno;
+
+#ifdef MQUEUE_RING
+	mq->slotv = mem_zalloc(MQUEUE_SIZE * sizeof(*mq->slotv), NULL);
+	if (!mq->slotv) {
+		err = ENOMEM;
 		goto out;
 	}
 
-	err = net_sockopt_blocking_set(mq->pfd[0], false);
-	if (err)
-		goto out;
+	for (i=0; i<MQUEUE_SIZE; i++)
+		atomic_init(&mq->slotv[i].seq, i);
 
-	err = net_sockopt_blocking_set(mq->pfd[1], false);
+	atomic_init(&mq->head, 0);
+	atomic_init(&mq->signalled, false);
+#endif
+
+	err = doorbell_alloc(mq);
 	if (err)
 		goto out;
 
@@ -146,10 +305,53 @@ int mqueue_alloc(struct mqueue **mqp, mqueue_h *h, void *arg)
  * @param id   General purpose Identifier
  * @param data Application data
  *
- * @return 0 if success, otherwise errorcode
+ * @return 0 if success, EAGAIN if the queue is full, otherwise errorcode
  */
 int mqueue_push(struct mqueue *mq, int id, void *data)
 {
+#ifdef MQUEUE_RING
+	struct slot *s;
+	size_t pos;
+
+	if (!mq)
+		return EINVAL;
+
+	pos = atomic_load_explicit(&mq->head, memory_order_relaxed);
+
+	for (;;) {
+		size_t seq;
+		intptr_t dif;
+
+		s   = &mq->slotv[pos & MQUEUE_MASK];
+		seq = atomic_load_explicit(&s->seq, memory_order_acquire);
+		dif = (intptr_t)seq - (intptr_t)pos;
+
+		if (dif == 0) {
+			if (atomic_compare_exchange_weak_explicit(&mq->head,
+						&pos, pos + 1,
+						memory_order_relaxed,
+						memory_order_relaxed))
+				break;
+		}
+		else if (dif < 0) {
+			return EAGAIN;
+		}
+		else {
+			pos = atomic_load_explicit(&mq->head,
+						   memory_order_relaxed);
+		}
+	}
+
+	s->id   = id;
+	s->data = data;
+
+	atomic_store_explicit(&s->seq, pos + 1, memory_order_release);
+
+	if (atomic_exchange(&mq->signalled, true))
+		return 0;
+
+	return doorbell_ring(mq);
+#else
 	struct msg msg;
 	ssize_t n;
 
@@ -165,4 +367,5 @@ int mqueue_push(struct mqueue *mq, int id, void *data)
 		return errno;
 
 	return (n != sizeof(msg)) ? EPIPE : 0;
+#endif
 }
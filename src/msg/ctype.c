@@ -8,6 +8,21 @@
 #include <re_msg.h>
 
 
+static inline bool is_lws(char c)
+{
+	return c == ' ' || c == '\t' || c == '\r' || c == '\n';
+}
+
+
+static inline const char *skip_lws(const char *p, const char *end)
+{
+	while (p < end && is_lws(*p))
+		++p;
+
+	return p;
+}
+
+
 /**
  * Decode a pointer-length string into Content-Type header
  *
@@ -18,21 +33,42 @@
  */
 int msg_ctype_decode(struct msg_ctype *ctype, const struct pl *pl)
 {
-	struct pl ws;
+	const char *p, *q, *end;
 
-	if (!ctype || !pl)
+	if (!ctype || !pl || !pl->p)
 		return EINVAL;
 
-	if (re_regex(pl->p, pl->l,
-		     "[ \t\r\n]*[^ \t\r\n;/]+[ \t\r\n]*/[ \t\r\n]*[^ \t\r\n;]+"
-		     "[^]*",
-		     &ws, &ctype->type, NULL, NULL, &ctype->subtype,
-		     &ctype->params))
+	end = pl->p + pl->l;
+
+	/* type / subtype params, with optional LWS between the tokens */
+	p = skip_lws(pl->p, end);
+
+	for (q = p; p < end && !is_lws(*p) && *p != ';' && *p != '/'; p++)
+		;
+	if (p == q)
 		return EBADMSG;
 
-	if (ws.p != pl->p)
+	ctype->type.p = q;
+	ctype->type.l = p - q;
+
+	p = skip_lws(p, end);
+
+	if (p == end || *p != '/')
 		return EBADMSG;
 
+	p = skip_lws(p + 1, end);
+
+	for (q = p; p < end && !is_lws(*p) && *p != ';'; p++)
+		;
+	if (p == q)
+		return EBADMSG;
+
+	ctype->subtype.p = q;
+	ctype->subtype.l = p - q;
+
+	ctype->params.p = p;
+	ctype->params.l = end - p;
+
 	return 0;
 }
 
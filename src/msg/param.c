@@ -3,11 +3,57 @@
  *
  * Copyright (C) 2010 Creytiv.com
  */
+#include <ctype.h>
 #include <re_types.h>
 #include <re_fmt.h>
 #include <re_msg.h>
 
 
+static inline bool is_lws(char c)
+{
+	return c == ' ' || c == '\t' || c == '\r' || c == '\n';
+}
+
+
+static inline const char *skip_lws(const char *p, const char *end)
+{
+	while (p < end && is_lws(*p))
+		++p;
+
+	return p;
+}
+
+
+/* End of a parameter value, which may contain quoted strings */
+static const char *value_end(const char *p, const char *end)
+{
+	bool quote = false, esc = false;
+
+	for (; p < end; p++) {
+
+		if (esc) {
+			esc = false;
+			continue;
+		}
+
+		if (*p == '\\') {
+			esc = true;
+			continue;
+		}
+
+		if (*p == '"') {
+			quote = !quote;
+			continue;
+		}
+
+		if (!quote && (is_lws(*p) || *p == ';'))
+			break;
+	}
+
+	return p;
+}
+
+
 /**
  * Check if a parameter exists
  *
@@ -51,20 +97,60 @@ int msg_param_exists(const struct pl *pl, const char *name, struct pl *val)
  */
 int msg_param_decode(const struct pl *pl, const char *name, struct pl *val)
 {
-	char expr[128];
-	struct pl v;
+	const char *s, *p, *q, *end;
+	size_t i;
 
-	if (!pl || !name || !val)
+	if (!pl || !name || !val || !pl->p)
 		return EINVAL;
 
-	(void)re_snprintf(expr, sizeof(expr),
-			  ";[ \t\r\n]*%s[ \t\r\n]*=[ \t\r\n]*[~ \t\r\n;]+",
-			  name);
+	end = pl->p + pl->l;
 
-	if (re_regex(pl->p, pl->l, expr, NULL, NULL, NULL, &v))
-		return ENOENT;
+	/* ";[ \t\r\n]*name[ \t\r\n]*=[ \t\r\n]*[~ \t\r\n;]+" as in re_regex(),
+	 * from the first position that matches */
+	for (s = pl->p; s < end; s++) {
 
-	*val = v;
+		if (*s != ';')
+			continue;
 
-	return 0;
+		p = skip_lws(s + 1, end);
+
+		for (i=0; name[i]; i++, p++) {
+
+			if (p == end)
+				return ENOENT;
+
+			if (tolower((uint8_t)*p) != tolower((uint8_t)name[i]))
+				break;
+		}
+
+		if (name[i])
+			continue;
+
+		p = skip_lws(p, end);
+
+		if (p == end)
+			return ENOENT;
+
+		if (*p != '=')
+			continue;
+
+		q = skip_lws(p + 1, end);
+		p = value_end(q, end);
+
+		/* strip quotes */
+		if (p - q > 1 && q[0] == '"' && p[-1] == '"') {
+			++q;
+			--p;
+		}
+
+		if (p == q)
+			continue;
+
+		val->p = q;
+		val->l = p - q;
+
+		return 0;
+	}
+
+	return ENOENT;
 }
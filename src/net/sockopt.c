@@ -3,6 +3,9 @@
  *
  * Copyright (C) 2010 Creytiv.com
  */
+#ifndef _DEFAULT_SOURCE
+#define _DEFAULT_SOURCE 1  /* SO_REUSEPORT with glibc in strict C mode */
+#endif
 #ifdef HAVE_UNISTD_H
 #include <unistd.h>
 #endif
@@ -93,7 +96,9 @@ int net_sockopt_reuse_set(int fd, bool reuse)
 	}
 #endif
 
-#ifdef SO_REUSEPORT
+	/* On Linux SO_REUSEPORT lets independent sockets share one address,
+	 * it must be requested explicitly with net_sockopt_reuseport_set() */
+#if defined(SO_REUSEPORT) && !defined(LINUX)
 	if (-1 == setsockopt(fd, SOL_SOCKET, SO_REUSEPORT,
 			     BUF_CAST &r, sizeof(r))) {
 		DEBUG_INFO("SO_REUSEPORT: %m\n", errno);
@@ -110,3 +115,32 @@ int net_sockopt_reuse_set(int fd, bool reuse)
 	return 0;
 #endif
 }
+
+
+/**
+ * Set socket option to share the local port with other sockets
+ * (SO_REUSEPORT). Must be set on all sockets before bind().
+ *
+ * @param fd     Socket file descriptor
+ * @param reuse  true for reuse, false for no reuse
+ *
+ * @return 0 if success, otherwise errorcode
+ */
+int net_sockopt_reuseport_set(int fd, bool reuse)
+{
+#ifdef SO_REUSEPORT
+	int r = reuse;
+
+	if (-1 == setsockopt(fd, SOL_SOCKET, SO_REUSEPORT,
+			     BUF_CAST &r, sizeof(r))) {
+		DEBUG_WARNING("SO_REUSEPORT: %m\n", errno);
+		return errno;
+	}
+
+	return 0;
+#else
+	(void)fd;
+	(void)reuse;
+	return ENOSYS;
+#endif
+}
@@ -112,6 +112,7 @@ int rtp_hdr_decode(struct rtp_header *hdr, struct mbuf *mb)
 	hdr->seq  = ntohs(mbuf_read_u16(mb));
 	hdr->ts   = ntohl(mbuf_read_u32(mb));
 	hdr->ssrc = ntohl(mbuf_read_u32(mb));
+	hdr->rx_ts = 0;
 
 	header_len = hdr->cc*sizeof(uint32_t);
 	if (mbuf_get_left(mb) < header_len)
@@ -205,9 +206,11 @@ static void udp_recv_handler(const struct sa *src, struct mbuf *mb, void *arg)
 	if (err)
 		return;
 
+	/* kernel arrival time, if enabled with udp_tstamp_set() */
+	hdr.rx_ts = udp_rx_tstamp(rs->sock_rtp);
+
 	if (rs->rtcp) {
-		rtcp_sess_rx_rtp(rs->rtcp, hdr.seq, hdr.ts,
-				 hdr.ssrc, mbuf_get_left(mb), src);
+		rtcp_sess_rx_rtp(rs->rtcp, &hdr, mbuf_get_left(mb), src);
 	}
 
 	if (rs->recvh)
@@ -14,6 +14,86 @@
 #include <re_sip.h>
 
 
+static inline bool is_lws(char c)
+{
+	return c == ' ' || c == '\t' || c == '\r' || c == '\n';
+}
+
+
+/*
+ * Same as re_regex() with "[~ \t\r\n<]*[ \t\r\n]*<[^>]+>[^]*", which
+ * matches from the first position where it can, so only the last word of
+ * an unquoted display-name is taken.
+ */
+static int decode_nameaddr(struct sip_addr *addr, const struct pl *pl)
+{
+	const char *s, *p, *q, *end = pl->p + pl->l;
+
+	for (s = pl->p; s < end; s++) {
+
+		bool quote = false, esc = false;
+
+		/* display-name, which may be a quoted string */
+		for (p = s; p < end; p++) {
+
+			if (esc) {
+				esc = false;
+				continue;
+			}
+
+			if (*p == '\\') {
+				esc = true;
+				continue;
+			}
+
+			if (*p == '"') {
+				quote = !quote;
+				continue;
+			}
+
+			if (!quote && (is_lws(*p) || *p == '<'))
+				break;
+		}
+
+		addr->dname.p = s;
+		addr->dname.l = p - s;
+
+		if (addr->dname.l > 1 && s[0] == '"' && p[-1] == '"') {
+			addr->dname.p += 1;
+			addr->dname.l -= 2;
+		}
+
+		while (p < end && is_lws(*p))
+			++p;
+
+		if (p == end)
+			return ENOENT;
+
+		if (*p != '<')
+			continue;
+
+		for (q = ++p; p < end && *p != '>'; p++)
+			;
+		if (p == q)
+			continue;
+		if (p == end)
+			return ENOENT;
+
+		addr->auri.p = q;
+		addr->auri.l = p - q;
+
+		++p;
+
+		addr->params.p = p;
+		addr->params.l = end - p;
+
+		return 0;
+	}
+
+	return ENOENT;
+}
+
+
 /**
  * Decode a pointer-length string into a SIP Address object
  *
@@ -26,13 +106,13 @@ int sip_addr_decode(struct sip_addr *addr, const struct pl *pl)
 {
 	int err;
 
-	if (!addr || !pl)
+	if (!addr || !pl || !pl->p)
 		return EINVAL;
 
 	memset(addr, 0, sizeof(*addr));
 
-	if (0 == re_regex(pl->p, pl->l, "[~ \t\r\n<]*[ \t\r\n]*<[^>]+>[^]*",
-			  &addr->dname, NULL, &addr->auri, &addr->params)) {
+	err = decode_nameaddr(addr, pl);
+	if (0 == err) {
 
 		if (!addr->dname.l)
 			addr->dname.p = NULL;
@@ -41,11 +121,25 @@ int sip_addr_decode(struct sip_addr *addr, const struct pl *pl)
 			addr->params.p = NULL;
 	}
 	else {
+		const char *p = pl->p, *end = pl->p + pl->l;
+
 		memset(addr, 0, sizeof(*addr));
 
-		if (re_regex(pl->p, pl->l, "[^;]+[^]*",
-			     &addr->auri, &addr->params))
+		/* "[^;]+[^]*" */
+		while (p < end && *p == ';')
+			++p;
+
+		if (p == end)
 			return EBADMSG;
+
+		addr->auri.p = p;
+
+		while (p < end && *p != ';')
+			++p;
+
+		addr->auri.l   = p - addr->auri.p;
+		addr->params.p = p;
+		addr->params.l = end - p;
 	}
 
 	err = uri_decode(&addr->uri, &addr->auri);
@@ -3,6 +3,7 @@
  *
  * Copyright (C) 2010 Creytiv.com
  */
+#include <ctype.h>
 #include <re_types.h>
 #include <re_fmt.h>
 #include <re_mbuf.h>
@@ -13,6 +14,12 @@
 #include <re_sip.h>
 
 
+static inline bool is_lws(char c)
+{
+	return c == ' ' || c == '\t' || c == '\r' || c == '\n';
+}
+
+
 /**
  * Decode a pointer-length string into a SIP CSeq header
  *
@@ -23,18 +30,41 @@
  */
 int sip_cseq_decode(struct sip_cseq *cseq, const struct pl *pl)
 {
+	const char *s, *p, *q, *end;
 	struct pl num;
-	int err;
 
-	if (!cseq || !pl)
+	if (!cseq || !pl || !pl->p)
 		return EINVAL;
 
-	err = re_regex(pl->p, pl->l, "[0-9]+[ \t\r\n]+[^ \t\r\n]+",
-		       &num, NULL, &cseq->met);
-	if (err)
-		return err;
+	end = pl->p + pl->l;
+
+	/* "[0-9]+[ \t\r\n]+[^ \t\r\n]+", from the first position that matches */
+	for (s = pl->p; s < end; s++) {
+
+		for (p = s; p < end && isdigit((uint8_t)*p); p++)
+			;
+		if (p == s)
+			continue;
+
+		num.p = s;
+		num.l = p - s;
+
+		for (q = p; p < end && is_lws(*p); p++)
+			;
+		if (p == q)
+			continue;
+
+		for (q = p; p < end && !is_lws(*p); p++)
+			;
+		if (p == q)
+			continue;
+
+		cseq->met.p = q;
+		cseq->met.l = p - q;
+		cseq->num   = pl_u32(&num);
 
-	cseq->num = pl_u32(&num);
+		return 0;
+	}
 
-	return 0;
+	return ENOENT;
 }
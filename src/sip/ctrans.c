@@ -50,6 +50,7 @@ struct sip_ctrans {
 	void *arg;
 	enum sip_transp tp;
 	enum state state;
+	uint32_t fhash;
 	uint32_t txc;
 	bool invite;
 };
@@ -207,7 +208,8 @@ static void retransmit_handler(void *arg)
 	tmr_start(&ct->tmre, timeout, retransmit_handler, ct);
 
 	err = sip_transp_send(&ct->qent, ct->sip, NULL, ct->tp, &ct->dst,
-			      ct->host, ct->mb, transport_handler, ct);
+			      ct->host, ct->fhash, ct->mb, transport_handler,
+			      ct);
 	if (err) {
 		terminate(ct, err);
 		mem_deref(ct);
@@ -311,8 +313,8 @@ static bool response_handler(const struct sip_msg *msg, void *arg)
 
 int sip_ctrans_request(struct sip_ctrans **ctp, struct sip *sip,
 		       enum sip_transp tp, const struct sa *dst, char *met,
-		       char *branch, char *host, struct mbuf *mb,
-		       sip_resp_h *resph, void *arg)
+		       char *branch, char *host, uint32_t fhash,
+		       struct mbuf *mb, sip_resp_h *resph, void *arg)
 {
 	struct sip_ctrans *ct;
 	int err;
@@ -333,12 +335,13 @@ int sip_ctrans_request(struct sip_ctrans **ctp, struct sip *sip,
 	ct->mb     = mem_ref(mb);
 	ct->dst    = *dst;
 	ct->tp     = tp;
+	ct->fhash  = fhash;
 	ct->sip    = sip;
 	ct->state  = ct->invite ? CALLING : TRYING;
 	ct->resph  = resph ? resph : dummy_handler;
 	ct->arg    = arg;
 
-	err = sip_transp_send(&ct->qent, sip, NULL, tp, dst, host, mb,
+	err = sip_transp_send(&ct->qent, sip, NULL, tp, dst, host, fhash, mb,
 			      transport_handler, ct);
 	if (err)
 		goto out;
@@ -389,7 +392,7 @@ int sip_ctrans_cancel(struct sip_ctrans *ct)
 		goto out;
 
 	err = sip_ctrans_request(NULL, ct->sip, ct->tp, &ct->dst, cancel,
-				 ct->branch, NULL, mb, NULL, NULL);
+				 ct->branch, NULL, ct->fhash, mb, NULL, NULL);
 	if (err)
 		goto out;
 
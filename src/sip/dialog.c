@@ -138,6 +138,7 @@ int sip_dialog_alloc(struct sip_dialog **dlgp,
 			   from_name ? "\"" : "", from_name,
 			   from_name ? "\" " : "",
 			   from_uri, ltag);
+	err |= mbuf_printf(dlg->mb, "Call-ID: %s\r\n", dlg->callid);
 	if (err)
 		goto out;
 
@@ -247,6 +248,7 @@ int sip_dialog_accept(struct sip_dialog **dlgp, const struct sip_msg *msg)
 	err |= mbuf_printf(dlg->mb, "To: %r\r\n", &msg->from.val);
 	err |= mbuf_printf(dlg->mb, "From: %r;tag=%016llx\r\n", &msg->to.val,
 			   msg->tag);
+	err |= mbuf_printf(dlg->mb, "Call-ID: %s\r\n", dlg->callid);
 	if (err)
 		goto out;
 
@@ -535,6 +537,10 @@ bool sip_dialog_rseq_valid(struct sip_dialog *dlg, const struct sip_msg *msg)
 }
 
 
+/*
+ * The Route set, To, From and Call-ID are rendered once per dialog, so
+ * only the CSeq is encoded per request
+ */
 int sip_dialog_encode(struct mbuf *mb, struct sip_dialog *dlg, uint32_t cseq,
 		      const char *met)
 {
@@ -544,9 +550,11 @@ int sip_dialog_encode(struct mbuf *mb, struct sip_dialog *dlg, uint32_t cseq,
 		return EINVAL;
 
 	err |= mbuf_write_mem(mb, mbuf_buf(dlg->mb), mbuf_get_left(dlg->mb));
-	err |= mbuf_printf(mb, "Call-ID: %s\r\n", dlg->callid);
-	err |= mbuf_printf(mb, "CSeq: %u %s\r\n", strcmp(met, "ACK") ?
-			   dlg->lseq++ : cseq, met);
+	err |= mbuf_write_str(mb, "CSeq: ");
+	err |= sip_write_u32(mb, strcmp(met, "ACK") ? dlg->lseq++ : cseq);
+	err |= mbuf_write_u8(mb, ' ');
+	err |= mbuf_write_str(mb, met);
+	err |= mbuf_write_str(mb, "\r\n");
 
 	return err;
 }
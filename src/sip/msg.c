@@ -22,25 +22,19 @@
 enum {
 	HDR_HASH_SIZE = 32,
 	STARTLINE_MAX = 8192,
+	ARENA_SIZE    = 2048,
 };
 
 
-static void hdr_destructor(void *arg)
-{
-	struct sip_hdr *hdr = arg;
-
-	list_unlink(&hdr->le);
-	hash_unlink(&hdr->he);
-}
-
-
 static void destructor(void *arg)
 {
 	struct sip_msg *msg = arg;
 
-	list_flush(&msg->hdrl);
-	hash_flush(msg->hdrht);
+	/* headers are owned by the arena */
+	list_clear(&msg->hdrl);
+	hash_clear(msg->hdrht);
 	mem_deref(msg->hdrht);
+	mem_deref(msg->arena);
 	mem_deref(msg->sock);
 	mem_deref(msg->mb);
 }
@@ -149,6 +143,45 @@ static inline bool hdr_comma_separated(enum sip_hdrid id)
 }
 
 
+/* decode headers that are deferred in lazy mode */
+static int hdr_decode_deferred(struct sip_msg *msg, const struct sip_hdr *hdr)
+{
+	int err = 0;
+
+	switch (hdr->id) {
+
+	case SIP_HDR_TO:
+		err = sip_addr_decode((struct sip_addr *)&msg->to, &hdr->val);
+		if (err)
+			break;
+
+		(void)msg_param_decode(&msg->to.params, "tag", &msg->to.tag);
+		msg->to.val = hdr->val;
+		break;
+
+	case SIP_HDR_FROM:
+		err = sip_addr_decode((struct sip_addr *)&msg->from,
+				      &hdr->val);
+		if (err)
+			break;
+
+		(void)msg_param_decode(&msg->from.params, "tag",
+				       &msg->from.tag);
+		msg->from.val = hdr->val;
+		break;
+
+	case SIP_HDR_CONTENT_TYPE:
+		err = msg_ctype_decode(&msg->ctyp, &hdr->val);
+		break;
+
+	default:
+		break;
+	}
+
+	return err;
+}
+
+
 static inline int hdr_add(struct sip_msg *msg, const struct pl *name,
 			  enum sip_hdrid id, const char *p, ssize_t l,
 			  bool atomic, bool line)
@@ -156,7 +189,7 @@ static inline int hdr_add(struct sip_msg *msg, const struct pl *name,
 	struct sip_hdr *hdr;
 	int err = 0;
 
-	hdr = mem_zalloc(sizeof(*hdr), hdr_destructor);
+	hdr = mem_arena_zalloc(msg->arena, sizeof(*hdr), NULL);
 	if (!hdr)
 		return ENOMEM;
 
@@ -172,15 +205,15 @@ static inline int hdr_add(struct sip_msg *msg, const struct pl *name,
 		if (!atomic)
 			break;
 
-		hash_append(msg->hdrht, id, &hdr->he, mem_ref(hdr));
-		list_append(&msg->hdrl, &hdr->le, mem_ref(hdr));
+		hash_append(msg->hdrht, id, &hdr->he, hdr);
+		list_append(&msg->hdrl, &hdr->le, hdr);
 		break;
 
 	default:
 		if (atomic)
-			hash_append(msg->hdrht, id, &hdr->he, mem_ref(hdr));
+			hash_append(msg->hdrht, id, &hdr->he, hdr);
 		if (line)
-			list_append(&msg->hdrl, &hdr->le, mem_ref(hdr));
+			list_append(&msg->hdrl, &hdr->le, hdr);
 		break;
 	}
 
@@ -195,23 +228,10 @@ static inline int hdr_add(struct sip_msg *msg, const struct pl *name,
 		break;
 
 	case SIP_HDR_TO:
-		err = sip_addr_decode((struct sip_addr *)&msg->to, &hdr->val);
-		if (err)
-			break;
-
-		(void)msg_param_decode(&msg->to.params, "tag", &msg->to.tag);
-		msg->to.val = hdr->val;
-		break;
-
 	case SIP_HDR_FROM:
-		err = sip_addr_decode((struct sip_addr *)&msg->from,
-				      &hdr->val);
-		if (err)
-			break;
-
-		(void)msg_param_decode(&msg->from.params, "tag",
-				       &msg->from.tag);
-		msg->from.val = hdr->val;
+	case SIP_HDR_CONTENT_TYPE:
+		if (!msg->lazy)
+			err = hdr_decode_deferred(msg, hdr);
 		break;
 
 	case SIP_HDR_CALL_ID:
@@ -226,10 +246,6 @@ static inline int hdr_add(struct sip_msg *msg, const struct pl *name,
 		msg->maxfwd = hdr->val;
 		break;
 
-	case SIP_HDR_CONTENT_TYPE:
-		err = msg_ctype_decode(&msg->ctyp, &hdr->val);
-		break;
-
 	case SIP_HDR_CONTENT_LENGTH:
 		msg->clen = hdr->val;
 		break;
@@ -243,23 +259,58 @@ static inline int hdr_add(struct sip_msg *msg, const struct pl *name,
 		break;
 	}
 
-	mem_deref(hdr);
-
 	return err;
 }
 
 
-/**
- * Decode a SIP message
- *
- * @param msgp Pointer to allocated SIP Message
- * @param mb   Buffer containing SIP Message
- *
- * @return 0 if success, otherwise errorcode
+static inline const char *skip_token(const char *p, const char *end)
+{
+	while (p < end && *p != ' ' && *p != '\t' && *p != '\r' && *p != '\n')
+		++p;
+
+	return p;
+}
+
+
+/*
+ * Decode the start line, "[^ \t\r\n]+ [^ \t\r\n]+ [^\r\n]*[\r]*[\n]1"
+ * from the start of the buffer. Returns a pointer to the first header.
  */
-int sip_msg_decode(struct sip_msg **msgp, struct mbuf *mb)
+static const char *startline_decode(const char *p, const char *end,
+				    struct pl *x, struct pl *y, struct pl *z)
+{
+	x->p = p;
+	p = skip_token(p, end);
+	x->l = p - x->p;
+
+	if (!x->l || p == end || *p++ != ' ')
+		return NULL;
+
+	y->p = p;
+	p = skip_token(p, end);
+	y->l = p - y->p;
+
+	if (!y->l || p == end || *p++ != ' ')
+		return NULL;
+
+	z->p = p;
+	while (p < end && *p != '\r' && *p != '\n')
+		++p;
+	z->l = p - z->p;
+
+	while (p < end && *p == '\r')
+		++p;
+
+	if (p == end || *p != '\n')
+		return NULL;
+
+	return p + 1;
+}
+
+
+static int msg_decode(struct sip_msg **msgp, struct mbuf *mb, bool lazy)
 {
-	struct pl x, y, z, e, name;
+	struct pl x, y, z, name;
 	const char *p, *v, *cv;
 	struct sip_msg *msg;
 	bool comsep, quote;
@@ -274,8 +325,8 @@ int sip_msg_decode(struct sip_msg **msgp, struct mbuf *mb)
 	p = (const char *)mbuf_buf(mb);
 	l = mbuf_get_left(mb);
 
-	if (re_regex(p, l, "[^ \t\r\n]+ [^ \t\r\n]+ [^\r\n]*[\r]*[\n]1",
-		     &x, &y, &z, NULL, &e) || x.p != (char *)mbuf_buf(mb))
+	v = startline_decode(p, p + l, &x, &y, &z);
+	if (!v)
 		return (l > STARTLINE_MAX) ? EBADMSG : ENODATA;
 
 	msg = mem_zalloc(sizeof(*msg), destructor);
@@ -286,9 +337,14 @@ int sip_msg_decode(struct sip_msg **msgp, struct mbuf *mb)
 	if (err)
 		goto out;
 
-	msg->tag = rand_u64();
-	msg->mb  = mem_ref(mb);
-	msg->req = (0 == pl_strcmp(&z, "SIP/2.0"));
+	err = mem_arena_alloc(&msg->arena, ARENA_SIZE);
+	if (err)
+		goto out;
+
+	msg->tag  = rand_u64();
+	msg->mb   = mem_ref(mb);
+	msg->req  = (0 == pl_strcmp(&z, "SIP/2.0"));
+	msg->lazy = lazy;
 
 	if (msg->req) {
 
@@ -296,7 +352,7 @@ int sip_msg_decode(struct sip_msg **msgp, struct mbuf *mb)
 		msg->ruri = y;
 		msg->ver = z;
 
-		if (uri_decode(&msg->uri, &y)) {
+		if (!lazy && uri_decode(&msg->uri, &y)) {
 			err = EBADMSG;
 			goto out;
 		}
@@ -312,8 +368,8 @@ int sip_msg_decode(struct sip_msg **msgp, struct mbuf *mb)
 		}
 	}
 
-	l -= e.p + e.l - p;
-	p = e.p + e.l;
+	l -= v - p;
+	p = v;
 
 	name.p = v = cv = NULL;
 	name.l = ws = lf = 0;
@@ -437,6 +493,88 @@ int sip_msg_decode(struct sip_msg **msgp, struct mbuf *mb)
 }
 
 
+/**
+ * Decode a SIP message
+ *
+ * @param msgp Pointer to allocated SIP Message
+ * @param mb   Buffer containing SIP Message
+ *
+ * @return 0 if success, otherwise errorcode
+ */
+int sip_msg_decode(struct sip_msg **msgp, struct mbuf *mb)
+{
+	return msg_decode(msgp, mb, false);
+}
+
+
+/**
+ * Decode a SIP message in lazy mode. Only the start line, the first Via,
+ * Call-ID, CSeq and the cached headers are decoded up front. The Request
+ * URI, To, From and Content-Type are left undecoded until
+ * sip_msg_hdrs_decode() is called.
+ *
+ * @param msgp Pointer to allocated SIP Message
+ * @param mb   Buffer containing SIP Message
+ *
+ * @return 0 if success, otherwise errorcode
+ */
+int sip_msg_decode_lazy(struct sip_msg **msgp, struct mbuf *mb)
+{
+	return msg_decode(msgp, mb, true);
+}
+
+
+/**
+ * Decode the headers of a SIP message that were deferred in lazy mode.
+ * Does nothing if the message is already fully decoded. Only used inside
+ * the SIP stack, which owns the message while it is passed as const to
+ * the listeners.
+ *
+ * @param msg SIP Message
+ *
+ * @return 0 if success, otherwise errorcode
+ */
+int sip_msg_hdrs_decode(const struct sip_msg *msg)
+{
+	struct sip_msg *m = (struct sip_msg *)msg;
+	static const enum sip_hdrid idv[] = {
+		SIP_HDR_TO, SIP_HDR_FROM, SIP_HDR_CONTENT_TYPE
+	};
+	size_t i;
+
+	if (!msg)
+		return EINVAL;
+
+	if (!msg->lazy)
+		return 0;
+
+	if (m->req && uri_decode(&m->uri, &m->ruri))
+		return EBADMSG;
+
+	for (i=0; i<ARRAY_SIZE(idv); i++) {
+
+		struct le *le = list_head(hash_list(m->hdrht, idv[i]));
+
+		for (; le; le = le->next) {
+
+			const struct sip_hdr *hdr = le->data;
+			int err;
+
+			if (hdr->id != idv[i])
+				continue;
+
+			err = hdr_decode_deferred(m, hdr);
+			if (err)
+				return err;
+		}
+	}
+
+	m->lazy = false;
+
+	return 0;
+}
+
+
 /**
  * Get a SIP Header from a SIP Message
  *
@@ -40,7 +40,11 @@ static int vreplyf(struct sip_strans **stp, struct mbuf **mbp, bool trans,
 		goto out;
 	}
 
-	err = mbuf_printf(mb, "SIP/2.0 %u %s\r\n", scode, reason);
+	err  = mbuf_write_str(mb, "SIP/2.0 ");
+	err |= sip_write_u32(mb, scode);
+	err |= mbuf_write_u8(mb, ' ');
+	err |= mbuf_write_str(mb, reason);
+	err |= mbuf_write_str(mb, "\r\n");
 
 	for (le = msg->hdrl.head; le; le = le->next) {
 
@@ -50,16 +54,18 @@ static int vreplyf(struct sip_strans **stp, struct mbuf **mbp, bool trans,
 		switch (hdr->id) {
 
 		case SIP_HDR_VIA:
-			err |= mbuf_printf(mb, "%r: ", &hdr->name);
+			err |= mbuf_write_pl(mb, &hdr->name);
+			err |= mbuf_write_str(mb, ": ");
 			if (viac++) {
-				err |= mbuf_printf(mb, "%r\r\n", &hdr->val);
+				err |= mbuf_write_pl(mb, &hdr->val);
+				err |= mbuf_write_str(mb, "\r\n");
 				break;
 			}
 
 			if (!msg_param_exists(&msg->via.params, "rport", &rp)){
 				err |= mbuf_write_pl_skip(mb, &hdr->val, &rp);
-				err |= mbuf_printf(mb, ";rport=%u",
-						   sa_port(&msg->src));
+				err |= mbuf_write_str(mb, ";rport=");
+				err |= sip_write_u32(mb, sa_port(&msg->src));
 				rport = true;
 			}
 			else
@@ -74,8 +80,9 @@ static int vreplyf(struct sip_strans **stp, struct mbuf **mbp, bool trans,
 			break;
 
 		case SIP_HDR_TO:
-			err |= mbuf_printf(mb, "%r: %r", &hdr->name,
-					   &hdr->val);
+			err |= mbuf_write_pl(mb, &hdr->name);
+			err |= mbuf_write_str(mb, ": ");
+			err |= mbuf_write_pl(mb, &hdr->val);
 			if (!pl_isset(&msg->to.tag) && scode > 100)
 				err |= mbuf_printf(mb, ";tag=%016llx",
 						   msg->tag);
@@ -91,8 +98,10 @@ static int vreplyf(struct sip_strans **stp, struct mbuf **mbp, bool trans,
 		case SIP_HDR_FROM:
 		case SIP_HDR_CALL_ID:
 		case SIP_HDR_CSEQ:
-			err |= mbuf_printf(mb, "%r: %r\r\n",
-					   &hdr->name, &hdr->val);
+			err |= mbuf_write_pl(mb, &hdr->name);
+			err |= mbuf_write_str(mb, ": ");
+			err |= mbuf_write_pl(mb, &hdr->val);
+			err |= mbuf_write_str(mb, "\r\n");
 			break;
 
 		default:
@@ -100,13 +109,16 @@ static int vreplyf(struct sip_strans **stp, struct mbuf **mbp, bool trans,
 		}
 	}
 
-	if (sip->software)
-		err |= mbuf_printf(mb, "Server: %s\r\n", sip->software);
+	if (sip->software) {
+		err |= mbuf_write_str(mb, "Server: ");
+		err |= mbuf_write_str(mb, sip->software);
+		err |= mbuf_write_str(mb, "\r\n");
+	}
 
 	if (fmt)
 		err |= mbuf_vprintf(mb, fmt, ap);
 	else
-		err |= mbuf_printf(mb, "Content-Length: 0\r\n\r\n");
+		err |= mbuf_write_str(mb, "Content-Length: 0\r\n\r\n");
 
 	if (err)
 		goto out;
@@ -36,6 +36,7 @@ struct sip_request {
 	sip_resp_h *resph;
 	void *arg;
 	size_t sortkey;
+	uint32_t fhash;
 	enum sip_transp tp;
 	bool tp_selected;
 	bool stateful;
@@ -180,7 +181,10 @@ static int request(struct sip_request *req, enum sip_transp tp,
 	if (err)
 		goto out;
 
-	err  = mbuf_printf(mb, "%s %s SIP/2.0\r\n", req->met, req->uri);
+	err  = mbuf_write_str(mb, req->met);
+	err |= mbuf_write_u8(mb, ' ');
+	err |= mbuf_write_str(mb, req->uri);
+	err |= mbuf_write_str(mb, " SIP/2.0\r\n");
 	err |= mbuf_printf(mb, "Via: SIP/2.0/%s %J;branch=%s;rport\r\n",
 			   sip_transp_name(tp), &laddr, branch);
 	err |= req->sendh ? req->sendh(tp, &laddr, dst, mb, req->arg) : 0;
@@ -191,10 +195,11 @@ static int request(struct sip_request *req, enum sip_transp tp,
 	mb->pos = 0;
 
 	if (!req->stateful)
-		err = sip_send(req->sip, NULL, tp, dst, mb);
+		err = sip_transp_send(NULL, req->sip, NULL, tp, dst, NULL,
+				      req->fhash, mb, NULL, NULL);
 	else
 		err = sip_ctrans_request(&req->ct, req->sip, tp, dst, req->met,
-					 branch, req->host, mb,
+					 branch, req->host, req->fhash, mb,
 					 response_handler, req);
 	if (err)
 		goto out;
@@ -637,6 +642,7 @@ int sip_request(struct sip_request **reqp, struct sip *sip, bool stateful,
 
 	req->stateful = stateful;
 	req->sortkey = sortkey;
+	req->fhash = sip_transp_fhash(sip, mb);
 	req->mb    = mem_ref(mb);
 	req->sip   = sip;
 	req->sendh = sendh;
@@ -779,6 +785,29 @@ int sip_requestf(struct sip_request **reqp, struct sip *sip, bool stateful,
 }
 
 
+static int dialog_hdrs_encode(struct mbuf *mb, struct sip *sip,
+			      const char *met, struct sip_dialog *dlg,
+			      uint32_t cseq, struct sip_auth *auth)
+{
+	int err;
+
+	err = mbuf_write_str(mb, "Max-Forwards: 70\r\n");
+
+	if (auth)
+		err |= sip_auth_encode(mb, auth, met, sip_dialog_uri(dlg));
+
+	err |= sip_dialog_encode(mb, dlg, cseq, met);
+
+	if (sip->software) {
+		err |= mbuf_write_str(mb, "User-Agent: ");
+		err |= mbuf_write_str(mb, sip->software);
+		err |= mbuf_write_str(mb, "\r\n");
+	}
+
+	return err;
+}
+
+
 /**
  * Send a SIP dialog request with formatted arguments
  *
@@ -812,16 +841,7 @@ int sip_drequestf(struct sip_request **reqp, struct sip *sip, bool stateful,
 	if (!mb)
 		return ENOMEM;
 
-	err = mbuf_write_str(mb, "Max-Forwards: 70\r\n");
-
-	if (auth)
-		err |= sip_auth_encode(mb, auth, met, sip_dialog_uri(dlg));
-
-	err |= sip_dialog_encode(mb, dlg, cseq, met);
-
-	if (sip->software)
-		err |= mbuf_printf(mb, "User-Agent: %s\r\n", sip->software);
-
+	err = dialog_hdrs_encode(mb, sip, met, dlg, cseq, auth);
 	if (err)
 		goto out;
 
@@ -847,6 +867,78 @@ int sip_drequestf(struct sip_request **reqp, struct sip *sip, bool stateful,
 }
 
 
+/**
+ * Send a SIP dialog request with a message body. Unlike sip_drequestf()
+ * nothing is formatted; the pre-rendered dialog headers are copied and
+ * only the CSeq and Content-Length are encoded per request.
+ *
+ * @param reqp     Pointer to allocated SIP request object
+ * @param sip      SIP Stack
+ * @param stateful Stateful client transaction
+ * @param met      Null-terminated SIP Method string
+ * @param dlg      SIP Dialog state
+ * @param cseq     CSeq number
+ * @param auth     SIP authentication state
+ * @param sendh    Send handler
+ * @param resph    Response handler
+ * @param arg      Handler argument
+ * @param hdrs     Additional SIP headers (optional)
+ * @param ctype    Content-Type of the body (optional)
+ * @param body     Message body (optional)
+ *
+ * @return 0 if success, otherwise errorcode
+ */
+int sip_drequest(struct sip_request **reqp, struct sip *sip, bool stateful,
+		 const char *met, struct sip_dialog *dlg, uint32_t cseq,
+		 struct sip_auth *auth, sip_send_h *sendh, sip_resp_h *resph,
+		 void *arg, const char *hdrs, const char *ctype,
+		 struct mbuf *body)
+{
+	const size_t len = body ? mbuf_get_left(body) : 0;
+	struct mbuf *mb;
+	int err;
+
+	if (!sip || !met || !dlg)
+		return EINVAL;
+
+	mb = mbuf_alloc(1024 + len);
+	if (!mb)
+		return ENOMEM;
+
+	err = dialog_hdrs_encode(mb, sip, met, dlg, cseq, auth);
+
+	if (hdrs)
+		err |= mbuf_write_str(mb, hdrs);
+
+	if (ctype && body) {
+		err |= mbuf_write_str(mb, "Content-Type: ");
+		err |= mbuf_write_str(mb, ctype);
+		err |= mbuf_write_str(mb, "\r\n");
+	}
+
+	err |= mbuf_write_str(mb, "Content-Length: ");
+	err |= sip_write_u32(mb, (uint32_t)len);
+	err |= mbuf_write_str(mb, "\r\n\r\n");
+
+	if (len)
+		err |= mbuf_write_mem(mb, mbuf_buf(body), len);
+
+	if (err)
+		goto out;
+
+	mb->pos = 0;
+
+	err = sip_request(reqp, sip, stateful, met, -1, sip_dialog_uri(dlg),
+			  -1, sip_dialog_route(dlg), mb, sip_dialog_hash(dlg),
+			  sendh, resph, arg);
+
+ out:
+	mem_deref(mb);
+
+	return err;
+}
+
+
 /**
  * Cancel a pending SIP Request
  *
@@ -207,23 +207,13 @@ void sip_close(struct sip *sip, bool force)
 int sip_send(struct sip *sip, void *sock, enum sip_transp tp,
 	     const struct sa *dst, struct mbuf *mb)
 {
-	return sip_transp_send(NULL, sip, sock, tp, dst, NULL, mb, NULL, NULL);
+	return sip_transp_send(NULL, sip, sock, tp, dst, NULL,
+			       sip_transp_fhash(sip, mb), mb, NULL, NULL);
 }
 
 
-/**
- * Listen for incoming SIP Requests and SIP Responses
- *
- * @param lsnrp Pointer to allocated listener
- * @param sip   SIP stack instance
- * @param req   True for Request, false for Response
- * @param msgh  SIP message handler
- * @param arg   Handler argument
- *
- * @return 0 if success, otherwise errorcode
- */
-int sip_listen(struct sip_lsnr **lsnrp, struct sip *sip, bool req,
-	       sip_msg_h *msgh, void *arg)
+static int lsnr_alloc(struct sip_lsnr **lsnrp, struct sip *sip, bool req,
+		      bool lazy, sip_msg_h *msgh, void *arg)
 {
 	struct sip_lsnr *lsnr;
 
@@ -239,6 +229,7 @@ int sip_listen(struct sip_lsnr **lsnrp, struct sip *sip, bool req,
 	lsnr->msgh = msgh;
 	lsnr->arg = arg;
 	lsnr->req = req;
+	lsnr->lazy = lazy;
 
 	if (lsnrp) {
 		lsnr->lsnrp = lsnrp;
@@ -249,6 +240,50 @@ int sip_listen(struct sip_lsnr **lsnrp, struct sip *sip, bool req,
 }
 
 
+/**
+ * Listen for incoming SIP Requests and SIP Responses
+ *
+ * @param lsnrp Pointer to allocated listener
+ * @param sip   SIP stack instance
+ * @param req   True for Request, false for Response
+ * @param msgh  SIP message handler
+ * @param arg   Handler argument
+ *
+ * @return 0 if success, otherwise errorcode
+ */
+int sip_listen(struct sip_lsnr **lsnrp, struct sip *sip, bool req,
+	       sip_msg_h *msgh, void *arg)
+{
+	return lsnr_alloc(lsnrp, sip, req, false, msgh, arg);
+}
+
+
+/*
+ * Listen for incoming SIP messages that may still be lazily decoded.
+ * The handler must call sip_msg_hdrs_decode() before using the Request
+ * URI, To, From or Content-Type.
+ */
+int sip_listen_lazy(struct sip *sip, bool req, sip_msg_h *msgh, void *arg)
+{
+	return lsnr_alloc(NULL, sip, req, true, msgh, arg);
+}
+
+
+/* Write a decimal number, for the fields that vary per message */
+int sip_write_u32(struct mbuf *mb, uint32_t v)
+{
+	char buf[10];
+	size_t i = sizeof(buf);
+
+	do {
+		buf[--i] = '0' + v % 10;
+		v /= 10;
+	} while (v);
+
+	return mbuf_write_mem(mb, (uint8_t *)buf + i, sizeof(buf) - i);
+}
+
+
 /**
  * Print debug information about the SIP stack
  *
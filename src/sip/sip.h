@@ -22,6 +22,7 @@ struct sip {
 	sip_trace_h *traceh;
 	void *arg;
 	bool closing;
+	bool ccert;
 	uint8_t tos;
 };
 
@@ -32,9 +33,14 @@ struct sip_lsnr {
 	sip_msg_h *msgh;
 	void *arg;
 	bool req;
+	bool lazy;
 };
 
 
+int  sip_listen_lazy(struct sip *sip, bool req, sip_msg_h *msgh, void *arg);
+int  sip_write_u32(struct mbuf *mb, uint32_t v);
+
+
 struct sip_keepalive {
 	struct le le;
 	struct sip_keepalive **kap;
@@ -43,6 +49,11 @@ struct sip_keepalive {
 };
 
 
+/* msg */
+int  sip_msg_decode_lazy(struct sip_msg **msgp, struct mbuf *mb);
+int  sip_msg_hdrs_decode(const struct sip_msg *msg);
+
+
 /* request */
 void sip_request_close(struct sip *sip);
 
@@ -52,8 +63,8 @@ struct sip_ctrans;
 
 int  sip_ctrans_request(struct sip_ctrans **ctp, struct sip *sip,
 			enum sip_transp tp, const struct sa *dst, char *met,
-			char *branch, char *host, struct mbuf *mb,
-			sip_resp_h *resph, void *arg);
+			char *branch, char *host, uint32_t fhash,
+			struct mbuf *mb, sip_resp_h *resph, void *arg);
 int  sip_ctrans_cancel(struct sip_ctrans *ct);
 int  sip_ctrans_init(struct sip *sip, uint32_t sz);
 int  sip_ctrans_debug(struct re_printf *pf, const struct sip *sip);
@@ -72,7 +83,9 @@ typedef void(sip_transp_h)(int err, void *arg);
 int  sip_transp_init(struct sip *sip, uint32_t sz);
 int  sip_transp_send(struct sip_connqent **qentp, struct sip *sip, void *sock,
 		     enum sip_transp tp, const struct sa *dst, char *host,
-		     struct mbuf *mb, sip_transp_h *transph, void *arg);
+		     uint32_t fhash, struct mbuf *mb, sip_transp_h *transph,
+		     void *arg);
+uint32_t sip_transp_fhash(const struct sip *sip, const struct mbuf *mb);
 bool sip_transp_supported(struct sip *sip, enum sip_transp tp, int af);
 const char *sip_transp_srvid(enum sip_transp tp);
 bool sip_transp_reliable(enum sip_transp tp);
@@ -256,7 +256,12 @@ static bool request_handler(const struct sip_msg *msg, void *arg)
 
 		return true;
 	}
-	else if (!pl_isset(&msg->to.tag)) {
+
+	/* not a retransmission, the rest of the message is needed now */
+	if (sip_msg_hdrs_decode(msg))
+		return false;
+
+	if (!pl_isset(&msg->to.tag)) {
 
 		st = list_ledata(hash_lookup(sip->ht_strans_mrg,
 					     hash_joaat_pl(&msg->callid),
@@ -403,7 +408,7 @@ int sip_strans_init(struct sip *sip, uint32_t sz)
 {
 	int err;
 
-	err = sip_listen(NULL, sip, true, request_handler, sip);
+	err = sip_listen_lazy(sip, true, request_handler, sip);
 	if (err)
 		return err;
 
@@ -38,6 +38,7 @@ enum {
 struct sip_ccert {
 	struct le he;
 	struct pl file;
+	uint32_t hash;
 };
 
 
@@ -280,6 +281,20 @@ static void conn_keepalive_handler(void *arg)
 }
 
 
+static bool hdrs_decode(const struct sip_msg *msg)
+{
+	int err;
+
+	err = sip_msg_hdrs_decode(msg);
+	if (err) {
+		(void)re_fprintf(stderr, "sip: msg decode err: %m\n", err);
+		return false;
+	}
+
+	return true;
+}
+
+
 static void sip_recv(struct sip *sip, const struct sip_msg *msg,
 		     size_t start)
 {
@@ -299,10 +314,16 @@ static void sip_recv(struct sip *sip, const struct sip_msg *msg,
 		if (msg->req != lsnr->req)
 			continue;
 
+		if (!lsnr->lazy && !hdrs_decode(msg))
+			return;
+
 		if (lsnr->msgh(msg, lsnr->arg))
 			return;
 	}
 
+	if (!hdrs_decode(msg))
+		return;
+
 	if (msg->req) {
 		(void)re_fprintf(stderr, "unhandeled request from %J: %r %r\n",
 				 &msg->src, &msg->met, &msg->ruri);
@@ -333,7 +354,10 @@ static void udp_recv_handler(const struct sa *src, struct mbuf *mb, void *arg)
 	if (mb->end <= 4)
 		return;
 
-	if (!stun_msg_decode(&stun_msg, mb, &ua)) {
+	if (stun_msg_detect(mb)) {
+
+		if (stun_msg_decode(&stun_msg, mb, &ua))
+			return;
 
 		if (stun_msg_method(stun_msg) == STUN_METHOD_BINDING) {
 
@@ -361,7 +385,7 @@ static void udp_recv_handler(const struct sa *src, struct mbuf *mb, void *arg)
 		return;
 	}
 
-	err = sip_msg_decode(&msg, mb);
+	err = sip_msg_decode_lazy(&msg, mb);
 	if (err) {
 		(void)re_fprintf(stderr, "sip: msg decode err: %m\n", err);
 		return;
@@ -445,7 +469,7 @@ static void tcp_recv_handler(struct mbuf *mb, void *arg)
 
 		pos = conn->mb->pos;
 
-		err = sip_msg_decode(&msg, conn->mb);
+		err = sip_msg_decode_lazy(&msg, conn->mb);
 		if (err) {
 			if (err == ENODATA)
 				err = 0;
@@ -642,43 +666,18 @@ static void tcp_connect_handler(const struct sa *paddr, void *arg)
 }
 
 #ifdef USE_TLS
-static uint32_t get_hash_of_fromhdr(struct mbuf *mb)
+static bool ccert_cmp_handler(struct le *le, void *arg)
 {
-	struct sip_msg *msg;
-	struct mbuf *sup = NULL;
-	uint32_t hsup = 0;
-	int err = 0;
-
-	err = sip_msg_decode(&msg, mb);
-	if (err)
-		return 0;
+	const struct sip_ccert *ccert = le->data;
 
-	sup = mbuf_alloc(30);
-	if (!sup)
-		return ENOMEM;
-
-	err = mbuf_printf(sup, "\"%r\" <%r:%r@%r:%d>", &msg->from.uri.user,
-		&msg->from.uri.scheme, &msg->from.uri.user,
-		&msg->from.uri.host, msg->from.uri.port);
-	if (err)
-		goto out;
-
-	mbuf_set_pos(sup, 0);
-	hsup = hash_joaat(mbuf_buf(sup), mbuf_get_left(sup));
-	mbuf_set_pos(mb, 0);
-
- out:
-	mem_deref(msg);
-	mem_deref(sup);
-
-	return hsup;
+	return ccert->hash == *(uint32_t *)arg;
 }
 #endif
 
 
 static int conn_send(struct sip_connqent **qentp, struct sip *sip, bool secure,
-		     const struct sa *dst, char *host, struct mbuf *mb,
-		     sip_transp_h *transph, void *arg)
+		     const struct sa *dst, char *host, uint32_t fhash,
+		     struct mbuf *mb, sip_transp_h *transph, void *arg)
 {
 	struct sip_conn *conn, *new_conn = NULL;
 	struct sip_connqent *qent;
@@ -686,6 +685,7 @@ static int conn_send(struct sip_connqent **qentp, struct sip *sip, bool secure,
 
 #ifndef USE_TLS
 	(void) host;
+	(void) fhash;
 #endif
 
 	conn = conn_find(sip, dst, secure);
@@ -723,8 +723,7 @@ static int conn_send(struct sip_connqent **qentp, struct sip *sip, bool secure,
 #ifdef USE_TLS
 	if (secure) {
 		const struct sip_transport *transp;
-		struct sip_ccert *ccert;
-		uint32_t hash = 0;
+		struct sip_ccert *ccert = NULL;
 
 		transp = transp_find(sip, SIP_TRANSP_TLS, sa_af(dst), dst);
 		if (!transp || !transp->tls) {
@@ -736,9 +735,11 @@ static int conn_send(struct sip_connqent **qentp, struct sip *sip, bool secure,
 		if (err)
 			goto out;
 
-		hash = get_hash_of_fromhdr(mb);
-		ccert = list_ledata(
-				list_head(hash_list(transp->ht_ccert, hash)));
+		if (fhash)
+			ccert = list_ledata(hash_lookup(transp->ht_ccert,
+							fhash,
+							ccert_cmp_handler,
+							&fhash));
 		if (ccert) {
 			char *f;
 			err = pl_strdup(&f, &ccert->file);
@@ -858,7 +859,7 @@ static void websock_recv_handler(const struct websock_hdr *hdr,
 
 	start = mb->pos;
 
-	err = sip_msg_decode(&msg, mb);
+	err = sip_msg_decode_lazy(&msg, mb);
 	if (err) {
 		(void)re_fprintf(stderr, "sip: msg decode err: %m\n", err);
 		return;
@@ -1218,6 +1219,32 @@ int sip_transp_add_websock(struct sip *sip, enum sip_transp tp,
 }
 
 
+/*
+ * Client certificates are looked up by the hash of the account identity,
+ * "username" <sip:username@address:port>
+ */
+static uint32_t ccert_hash(const struct uri *uri)
+{
+	struct mbuf *sup;
+	uint32_t hsup = 0;
+
+	sup = mbuf_alloc(64);
+	if (!sup)
+		return 0;
+
+	if (mbuf_printf(sup, "\"%r\" <%r:%r@%r:%d>", &uri->user,
+			&uri->scheme, &uri->user, &uri->host, uri->port))
+		goto out;
+
+	hsup = hash_joaat(sup->buf, sup->end);
+
+ out:
+	mem_deref(sup);
+
+	return hsup;
+}
+
+
 /**
  * Add a client certificate to the TLS transport object
  * Client certificates are saved as hash-table.
@@ -1232,54 +1259,110 @@ int sip_transp_add_websock(struct sip *sip, enum sip_transp tp,
 int sip_transp_add_ccert(struct sip *sip, const struct uri *uri,
 			 const char *cert)
 {
-	int err = 0;
 	const struct sip_transport *transp = NULL;
 	struct sip_ccert *ccert = NULL;
-	struct mbuf *sup = NULL;
-	uint32_t hsup = 0;
+	uint32_t hsup;
 
 	if (!sip || !uri || !cert)
 		return EINVAL;
 
-	sup = mbuf_alloc(30);
-	if (!sup)
+	hsup = ccert_hash(uri);
+	if (!hsup)
 		return ENOMEM;
 
-	err = mbuf_printf(sup, "\"%r\" <%r:%r@%r:%d>", &uri->user,
-		&uri->scheme, &uri->user, &uri->host, uri->port);
-	if (err)
-		goto out;
-
-	mbuf_set_pos(sup, 0);
-
-	hsup = hash_joaat(mbuf_buf(sup), mbuf_get_left(sup));
 	transp = transp_find(sip, SIP_TRANSP_TLS, AF_INET, NULL);
 	if (transp) {
 		ccert = mem_zalloc(sizeof(*ccert), NULL);
-		if (!ccert) {
-			err = ENOMEM;
-			goto out;
-		}
+		if (!ccert)
+			return ENOMEM;
 
 		pl_set_str(&ccert->file, cert);
+		ccert->hash = hsup;
 		hash_append(transp->ht_ccert, hsup, &ccert->he, ccert);
+		sip->ccert = true;
 	}
 
 	transp = transp_find(sip, SIP_TRANSP_TLS, AF_INET6, NULL);
 	if (transp) {
 		ccert = mem_zalloc(sizeof(*ccert), NULL);
-		if (!ccert) {
-			err = ENOMEM;
-			goto out;
-		}
+		if (!ccert)
+			return ENOMEM;
 
 		pl_set_str(&ccert->file, cert);
+		ccert->hash = hsup;
 		hash_append(transp->ht_ccert, hsup, &ccert->he, ccert);
+		sip->ccert = true;
 	}
 
- out:
-	mem_deref(sup);
-	return err;
+	return 0;
+}
+
+
+/*
+ * Hash of the From identity of an outgoing message, used to select a TLS
+ * client certificate. The From header is looked up in the headers of mb.
+ * Returns 0 if no client certificates are added, or if there is no valid
+ * From header.
+ */
+uint32_t sip_transp_fhash(const struct sip *sip, const struct mbuf *mb)
+{
+	const char *p, *end;
+
+	if (!sip || !sip->ccert || !mb)
+		return 0;
+
+	p   = (const char *)mbuf_buf(mb);
+	end = p + mbuf_get_left(mb);
+
+	while (p < end) {
+
+		const char *eol = memchr(p, '\n', end - p);
+		const char *colon;
+		struct sip_addr addr;
+		struct pl name, val;
+
+		if (!eol)
+			eol = end;
+
+		name.p = p;
+		p = eol + 1;
+
+		colon = memchr(name.p, ':', eol - name.p);
+		if (!colon) {
+			if (eol - name.p <= 1)
+				break;  /* end of headers */
+
+			continue;
+		}
+
+		name.l = colon - name.p;
+		while (name.l && (name.p[name.l-1] == ' ' ||
+				  name.p[name.l-1] == '\t'))
+			--name.l;
+
+		if (pl_strcasecmp(&name, "From") && pl_strcasecmp(&name, "f"))
+			continue;
+
+		val.p = colon + 1;
+		val.l = eol - val.p;
+
+		while (val.l && (*val.p == ' ' || *val.p == '\t')) {
+			++val.p;
+			--val.l;
+		}
+
+		while (val.l && (val.p[val.l-1] == '\r' ||
+				 val.p[val.l-1] == ' ' ||
+				 val.p[val.l-1] == '\t'))
+			--val.l;
+
+		if (sip_addr_decode(&addr, &val))
+			return 0;
+
+		return ccert_hash(&addr.uri);
+	}
+
+	return 0;
 }
 
 
@@ -1300,7 +1383,8 @@ void sip_transp_flush(struct sip *sip)
 
 int sip_transp_send(struct sip_connqent **qentp, struct sip *sip, void *sock,
 		    enum sip_transp tp, const struct sa *dst, char *host,
-		    struct mbuf *mb, sip_transp_h *transph, void *arg)
+		    uint32_t fhash, struct mbuf *mb, sip_transp_h *transph,
+		    void *arg)
 {
 	const struct sip_transport *transp;
 	struct sip_conn *conn;
@@ -1340,8 +1424,8 @@ int sip_transp_send(struct sip_connqent **qentp, struct sip *sip, void *sock,
 			err = tcp_send(conn->tc, mb);
 		}
 		else
-			err = conn_send(qentp, sip, secure, dst, host, mb,
-					transph, arg);
+			err = conn_send(qentp, sip, secure, dst, host, fhash,
+					mb, transph, arg);
 		break;
 
 	case SIP_TRANSP_WSS:
@@ -3,6 +3,7 @@
  *
  * Copyright (C) 2010 Creytiv.com
  */
+#include <ctype.h>
 #include <re_types.h>
 #include <re_fmt.h>
 #include <re_mbuf.h>
@@ -13,17 +14,38 @@
 #include <re_sip.h>
 
 
-static int decode_hostport(const struct pl *hostport, struct pl *host,
-			   struct pl *port)
+static inline bool is_lws(char c)
 {
-	/* Try IPv6 first */
-	if (!re_regex(hostport->p, hostport->l, "\\[[0-9a-f:]+\\][:]*[0-9]*",
-		      host, NULL, port))
-		return 0;
-
-	/* Then non-IPv6 host */
-	return re_regex(hostport->p, hostport->l, "[^:]+[:]*[0-9]*",
-			host, NULL, port);
+	return c == ' ' || c == '\t' || c == '\r' || c == '\n';
+}
+
+
+static inline const char *skip_lws(const char *p, const char *end)
+{
+	while (p < end && is_lws(*p))
+		++p;
+
+	return p;
+}
+
+
+/* Match a literal, 1 if match, 0 if no match, -1 if the input ends */
+static int literal(const char **pp, const char *end, const char *lit)
+{
+	const char *p = *pp;
+
+	for (; *lit; lit++, p++) {
+
+		if (p == end)
+			return -1;
+
+		if (tolower((uint8_t)*p) != tolower((uint8_t)*lit))
+			return 0;
+	}
+
+	*pp = p;
+
+	return 1;
 }
 
 
@@ -37,19 +59,66 @@ static int decode_hostport(const struct pl *hostport, struct pl *host,
  */
 int sip_via_decode(struct sip_via *via, const struct pl *pl)
 {
+	static const char *const litv[] = {"SIP", "/", "2.0", "/"};
 	struct pl transp, host, port;
+	const char *s, *p, *q, *end;
+	size_t i;
 	int err;
 
-	if (!via || !pl)
+	if (!via || !pl || !pl->p)
 		return EINVAL;
 
-	err = re_regex(pl->p, pl->l,
-		       "SIP[  \t\r\n]*/[ \t\r\n]*2.0[ \t\r\n]*/[ \t\r\n]*"
-		       "[A-Z]+[ \t\r\n]*[^; \t\r\n]+[ \t\r\n]*[^]*",
-		       NULL, NULL, NULL, NULL, &transp,
-		       NULL, &via->sentby, NULL, &via->params);
-	if (err)
-		return err;
+	end = pl->p + pl->l;
+
+	/* SIP / 2.0 / transport sent-by params, with optional LWS between
+	 * the tokens. Matched like re_regex(), from the first position that
+	 * matches */
+	for (s = pl->p; s < end; s++) {
+
+		p = s;
+
+		for (i=0; i<ARRAY_SIZE(litv); i++) {
+
+			int r = literal(&p, end, litv[i]);
+			if (r < 0)
+				return ENOENT;
+			if (!r)
+				break;
+
+			p = skip_lws(p, end);
+		}
+
+		if (i < ARRAY_SIZE(litv))
+			continue;
+
+		for (q = p; p < end && isalpha((uint8_t)*p); p++)
+			;
+		if (p == q)
+			continue;
+
+		transp.p = q;
+		transp.l = p - q;
+
+		p = skip_lws(p, end);
+
+		for (q = p; p < end && *p != ';' && !is_lws(*p); p++)
+			;
+		if (p == q)
+			continue;
+
+		via->sentby.p = q;
+		via->sentby.l = p - q;
+
+		p = skip_lws(p, end);
+
+		via->params.p = p;
+		via->params.l = end - p;
+
+		break;
+	}
+
+	if (s == end)
+		return ENOENT;
 
 	if (!pl_strcmp(&transp, "TCP"))
 		via->tp = SIP_TRANSP_TCP;
@@ -60,7 +129,7 @@ int sip_via_decode(struct sip_via *via, const struct pl *pl)
 	else
 		via->tp = SIP_TRANSP_NONE;
 
-	err = decode_hostport(&via->sentby, &host, &port);
+	err = uri_decode_hostport(&via->sentby, &host, &port);
 	if (err)
 		return err;
 
@@ -95,18 +95,9 @@ int sipsess_ack(struct sipsess_sock *sock, struct sip_dialog *dlg,
 	ack->dlg  = mem_ref(dlg);
 	ack->cseq = cseq;
 
-	err = sip_drequestf(&ack->req, sock->sip, false, "ACK", dlg, cseq,
-			    auth, send_handler, resp_handler, ack,
-			    "%s%s%s"
-			    "Content-Length: %zu\r\n"
-			    "\r\n"
-			    "%b",
-			    desc ? "Content-Type: " : "",
-			    desc ? ctype : "",
-			    desc ? "\r\n" : "",
-			    desc ? mbuf_get_left(desc) : (size_t)0,
-			    desc ? mbuf_buf(desc) : NULL,
-			    desc ? mbuf_get_left(desc) : (size_t)0);
+	err = sip_drequest(&ack->req, sock->sip, false, "ACK", dlg, cseq,
+			   auth, send_handler, resp_handler, ack,
+			   NULL, ctype, desc);
 	if (err)
 		goto out;
 
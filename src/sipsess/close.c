@@ -64,11 +64,8 @@ int sipsess_bye(struct sipsess *sess, bool reset_ls)
 	if (reset_ls)
 		sip_loopstate_reset(&sess->ls);
 
-	return sip_drequestf(&sess->req, sess->sip, true, "BYE",
-			     sess->dlg, 0, sess->auth,
-			     NULL, bye_resp_handler, sess,
-			     "%s"
-			     "Content-Length: 0\r\n"
-			     "\r\n",
-			     sess->close_hdrs);
+	return sip_drequest(&sess->req, sess->sip, true, "BYE",
+			    sess->dlg, 0, sess->auth,
+			    NULL, bye_resp_handler, sess,
+			    sess->close_hdrs, NULL, NULL);
 }
@@ -130,19 +130,10 @@ int sipsess_reinvite(struct sipsess *sess, bool reset_ls)
 	if (reset_ls)
 		sip_loopstate_reset(&sess->ls);
 
-	return sip_drequestf(&sess->req, sess->sip, true, "INVITE",
-			     sess->dlg, 0, sess->auth,
-			     send_handler, reinvite_resp_handler, sess,
-			     "%s%s%s"
-			     "Content-Length: %zu\r\n"
-			     "\r\n"
-			     "%b",
-			     sess->desc ? "Content-Type: " : "",
-			     sess->desc ? sess->ctype : "",
-			     sess->desc ? "\r\n" : "",
-			     sess->desc ? mbuf_get_left(sess->desc) :(size_t)0,
-			     sess->desc ? mbuf_buf(sess->desc) : NULL,
-			     sess->desc ? mbuf_get_left(sess->desc):(size_t)0);
+	return sip_drequest(&sess->req, sess->sip, true, "INVITE",
+			    sess->dlg, 0, sess->auth,
+			    send_handler, reinvite_resp_handler, sess,
+			    NULL, sess->ctype, sess->desc);
 }
 
 
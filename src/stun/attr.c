@@ -176,8 +176,9 @@ int stun_attr_encode(struct mbuf *mb, uint16_t type, const void *v,
 }
 
 
-int stun_attr_decode(struct stun_attr **attrp, struct mbuf *mb,
-		     const uint8_t *tid, struct stun_unknown_attr *ua)
+int stun_attr_decode(struct stun_attr **attrp, struct mem_arena *arena,
+		     struct mbuf *mb, const uint8_t *tid,
+		     struct stun_unknown_attr *ua)
 {
 	struct stun_attr *attr;
 	size_t start, len;
@@ -190,7 +191,7 @@ int stun_attr_decode(struct stun_attr **attrp, struct mbuf *mb,
 	if (mbuf_get_left(mb) < 4)
 		return EBADMSG;
 
-	attr = mem_zalloc(sizeof(*attr), destructor);
+	attr = mem_arena_zalloc(arena, sizeof(*attr), destructor);
 	if (!attr)
 		return ENOMEM;
 
@@ -344,8 +345,7 @@ int stun_attr_decode(struct stun_attr **attrp, struct mbuf *mb,
  badmsg:
 	err = EBADMSG;
  error:
-	mem_deref(attr);
-
+	/* attr is released with the arena */
 	return err;
 }
 
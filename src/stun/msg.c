@@ -42,9 +42,14 @@ enum {
    '---------------------'
    </pre>
 */
+enum {
+	ARENA_SIZE = 1024,
+};
+
 struct stun_msg {
 	struct stun_hdr hdr;
 	struct list attrl;
+	struct mem_arena *arena;
 	struct mbuf *mb;
 	size_t start;
 };
@@ -60,7 +65,9 @@ static void destructor(void *arg)
 {
 	struct stun_msg *msg = arg;
 
-	list_flush(&msg->attrl);
+	/* attributes are owned by the arena */
+	list_clear(&msg->attrl);
+	mem_deref(msg->arena);
 	mem_deref(msg->mb);
 }
 
@@ -105,6 +112,13 @@ int stun_msg_decode(struct stun_msg **msgpp, struct mbuf *mb,
 	msg->mb = mem_ref(mb);
 	msg->start = start;
 
+	err = mem_arena_alloc(&msg->arena, ARENA_SIZE);
+	if (err) {
+		mem_deref(msg);
+		mb->pos = start;
+		return err;
+	}
+
 	if (ua)
 		ua->typec = 0;
 
@@ -115,7 +129,7 @@ int stun_msg_decode(struct stun_msg **msgpp, struct mbuf *mb,
 
 		struct stun_attr *attr;
 
-		err = stun_attr_decode(&attr, mb, hdr.tid, ua);
+		err = stun_attr_decode(&attr, msg->arena, mb, hdr.tid, ua);
 		if (err)
 			break;
 
@@ -185,6 +199,42 @@ const uint8_t *stun_msg_tid(const struct stun_msg *msg)
 }
 
 
+/**
+ * Check if a buffer holds a STUN message, without decoding it. This is
+ * used to demultiplex STUN from other protocols on a shared socket, as
+ * described in RFC 7983. Only STUN messages with the magic cookie are
+ * detected.
+ *
+ * @param mb Buffer to check, from the current position
+ *
+ * @return true if STUN message, otherwise false
+ */
+bool stun_msg_detect(const struct mbuf *mb)
+{
+	const uint8_t *p;
+	uint32_t cookie;
+	size_t len;
+
+	if (!mb || mbuf_get_left(mb) < STUN_HEADER_SIZE)
+		return false;
+
+	p = mbuf_buf(mb);
+
+	/* the two most significant bits must be zero */
+	if (p[0] > 3)
+		return false;
+
+	len = (size_t)p[2] << 8 | p[3];
+	if (len & 0x3 || mbuf_get_left(mb) < STUN_HEADER_SIZE + len)
+		return false;
+
+	cookie = (uint32_t)p[4] << 24 | (uint32_t)p[5] << 16 |
+		 (uint32_t)p[6] << 8  | (uint32_t)p[7];
+
+	return cookie == STUN_MAGIC_COOKIE;
+}
+
+
 /**
  * Check if a STUN Message has the magic cookie
  *
@@ -48,8 +48,10 @@ int stun_hdr_decode(struct mbuf *mb, struct stun_hdr *hdr);
 
 int stun_attr_encode(struct mbuf *mb, uint16_t type, const void *v,
 		     const uint8_t *tid, uint8_t padding);
-int stun_attr_decode(struct stun_attr **attrp, struct mbuf *mb,
-		     const uint8_t *tid, struct stun_unknown_attr *ua);
+struct mem_arena;
+int stun_attr_decode(struct stun_attr **attrp, struct mem_arena *arena,
+		     struct mbuf *mb, const uint8_t *tid,
+		     struct stun_unknown_attr *ua);
 void stun_attr_dump(const struct stun_attr *a);
 
 int  stun_addr_encode(struct mbuf *mb, const struct sa *addr,
@@ -107,9 +107,18 @@ uint32_t rand_u32(void)
  */
 uint64_t rand_u64(void)
 {
+	uint64_t v;
+
 	RAND_CHECK;
 
-	return (uint64_t)rand_u32()<<32 | rand_u32();
+#if defined(USE_OPENSSL) || defined(HAVE_ARC4RANDOM)
+	/* one call to the generator for all 64 bits */
+	rand_bytes((uint8_t *)&v, sizeof(v));
+#else
+	v = (uint64_t)rand_u32()<<32 | rand_u32();
+#endif
+
+	return v;
 }
 
 
@@ -3,6 +3,9 @@
  *
  * Copyright (C) 2010 Creytiv.com
  */
+#ifdef LINUX
+#define _GNU_SOURCE 1  /**< accept4(), MSG_ZEROCOPY and SO_ZEROCOPY */
+#endif
 #include <stdlib.h>
 #ifdef HAVE_UNISTD_H
 #include <unistd.h>
@@ -20,6 +23,18 @@
 #include "TargetConditionals.h"
 #endif
 #include <string.h>
+#ifdef LINUX
+#include <sys/socket.h>
+#include <netinet/in.h>
+#include <netinet/tcp.h>
+#include <time.h>
+#include <linux/errqueue.h>
+#define TCP_ACCEPT4 1   /**< Accept with socket flags */
+#if defined(MSG_ZEROCOPY) && defined(SO_ZEROCOPY) && \
+	defined(SO_EE_ORIGIN_ZEROCOPY)
+#define TCP_ZEROCOPY 1  /**< Zero-copy send */
+#endif
+#endif
 #include <re_types.h>
 #include <re_fmt.h>
 #include <re_mem.h>
@@ -51,7 +66,11 @@
 
 enum {
 	TCP_TXQSZ_DEFAULT = 524288,
-	TCP_RXSZ_DEFAULT  = 8192
+	TCP_RXSZ_DEFAULT  = 8192,
+	TCP_RXBUDGET_DEFAULT = 1,
+	TCP_ACCEPTBUDGET_DEFAULT = 1,
+	TCP_IOV_MAX = 64,
+	TCP_ZEROCOPY_MIN = 16384
 };
 
 
@@ -61,6 +80,7 @@ struct tcp_sock {
 	int fdc;              /**< Cached connection file descriptor */
 	tcp_conn_h *connh;    /**< TCP Connect handler               */
 	void *arg;            /**< Handler argument                  */
+	uint32_t acceptbudget; /**< Max connections accepted per event */
 	uint8_t tos;          /**< Type-of-service field             */
 };
 
@@ -76,11 +96,17 @@ struct tcp_conn {
 	tcp_close_h *closeh;  /**< Connection close handler          */
 	void *arg;            /**< Handler argument                  */
 	size_t rxsz;          /**< Maximum receive chunk size        */
+	uint32_t rxbudget;    /**< Max receive chunks per event      */
 	size_t txqsz;
 	size_t txqsz_max;
 	bool active;          /**< We are connecting flag            */
 	bool connected;       /**< Connection is connected flag      */
+	bool zerocopy;        /**< Zero-copy send enabled            */
 	uint8_t tos;          /**< Type-of-service field             */
+#ifdef TCP_ZEROCOPY
+	struct list zcl;      /**< Pinned zero-copy sends            */
+	uint32_t zcid;        /**< Next zero-copy send identifier    */
+#endif
 };
 
 
@@ -95,10 +121,30 @@ struct tcp_helper {
 };
 
 
+/*
+ * A queue entry either owns a copy of the data, or references the buffer
+ * of an mbuf that was passed to tcp_send_vec(). In both cases mb is the
+ * unsent part. The queue is flushed with one system call where possible.
+ */
 struct tcp_qent {
 	struct le le;
-	struct mbuf mb;
+	struct mbuf mb;       /**< Unsent data                       */
+	struct mbuf *ref;     /**< Referenced mbuf, NULL if copied   */
+};
+
+
+#ifdef TCP_ZEROCOPY
+/*
+ * The buffers of one zero-copy send call are pinned until the kernel
+ * reports the completion of its identifier on the socket error queue.
+ */
+struct tcp_zcent {
+	struct le le;
+	uint32_t id;          /**< Send call identifier              */
+	size_t n;             /**< Number of pinned objects          */
+	void *objv[];         /**< Pinned objects                    */
 };
+#endif
 
 
 static void tcp_recv_handler(int flags, void *arg);
@@ -157,6 +203,10 @@ static void conn_destructor(void *data)
 		fd_close(tc->fdc);
 		(void)close(tc->fdc);
 	}
+
+#ifdef TCP_ZEROCOPY
+	list_flush(&tc->zcl);
+#endif
 }
 
 
@@ -173,7 +223,21 @@ static void qent_destructor(void *arg)
 	struct tcp_qent *qe = arg;
 
 	list_unlink(&qe->le);
-	mem_deref(qe->mb.buf);
+
+	if (qe->ref)
+		mem_deref(qe->ref);
+	else
+		mem_deref(qe->mb.buf);
+}
+
+
+/* Poll for writing when the first entry is queued */
+static int sendq_start(struct tcp_conn *tc)
+{
+	if (tc->sendq.head || tc->sendh)
+		return 0;
+
+	return fd_listen(tc->fdc, FD_READ | FD_WRITE, tcp_recv_handler, tc);
 }
 
 
@@ -186,13 +250,9 @@ static int enqueue(struct tcp_conn *tc, struct mbuf *mb)
 	if (tc->txqsz + n > tc->txqsz_max)
 		return ENOSPC;
 
-	if (!tc->sendq.head && !tc->sendh) {
-
-		err = fd_listen(tc->fdc, FD_READ | FD_WRITE,
-				tcp_recv_handler, tc);
-		if (err)
-			return err;
-	}
+	err = sendq_start(tc);
+	if (err)
+		return err;
 
 	qe = mem_zalloc(sizeof(*qe), qent_destructor);
 	if (!qe)
@@ -214,15 +274,214 @@ static int enqueue(struct tcp_conn *tc, struct mbuf *mb)
 }
 
 
-static int dequeue(struct tcp_conn *tc)
+/* Queue the data of mb from pos by reference */
+static int enqueue_ref(struct tcp_conn *tc, struct mbuf *mb, size_t pos)
 {
-	struct tcp_qent *qe = list_ledata(tc->sendq.head);
-	ssize_t n;
+	struct tcp_qent *qe;
+	int err;
+
+	if (tc->txqsz + mb->end - pos > tc->txqsz_max)
+		return ENOSPC;
+
+	err = sendq_start(tc);
+	if (err)
+		return err;
+
+	qe = mem_zalloc(sizeof(*qe), qent_destructor);
+	if (!qe)
+		return ENOMEM;
+
+	list_append(&tc->sendq, &qe->le, qe);
+
+	qe->ref     = mem_ref(mb);
+	qe->mb.buf  = mb->buf;
+	qe->mb.size = mb->size;
+	qe->mb.pos  = pos;
+	qe->mb.end  = mb->end;
+
+	tc->txqsz += mb->end - pos;
+
+	return 0;
+}
+
+
+/* Remove n sent bytes from the head of the send queue */
+static void sendq_consume(struct tcp_conn *tc, size_t n)
+{
+	tc->txqsz -= n;
+
+	while (n) {
+		struct tcp_qent *qe = list_ledata(tc->sendq.head);
+		const size_t len = mbuf_get_left(&qe->mb);
+
+		if (n < len) {
+			qe->mb.pos += n;
+			break;
+		}
+
+		n -= len;
+		mem_deref(qe);
+	}
+}
+
+
+#ifdef TCP_ZEROCOPY
+static void zcent_destructor(void *data)
+{
+	struct tcp_zcent *ze = data;
+	size_t i;
+
+	list_unlink(&ze->le);
+
+	for (i=0; i<ze->n; i++)
+		mem_deref(ze->objv[i]);
+}
+
+
+/* Release the pinned sends with identifiers from lo to hi */
+static void zc_release(struct tcp_conn *tc, uint32_t lo, uint32_t hi)
+{
+	struct le *le = tc->zcl.head;
+
+	while (le) {
+		struct tcp_zcent *ze = le->data;
+
+		le = le->next;
+
+		if ((uint32_t)(ze->id - lo) <= (uint32_t)(hi - lo))
+			mem_deref(ze);
+	}
+}
+
+
+/* Read all zero-copy completions from the socket error queue */
+static void zc_complete(struct tcp_conn *tc)
+{
+	for (;;) {
+		union {
+			char buf[2 * CMSG_SPACE(sizeof(struct sock_extended_err))];
+			size_t align;  /* alignment of struct cmsghdr */
+		} ctrl;
+		struct cmsghdr *cmsg;
+		struct msghdr msg;
+
+		memset(&msg, 0, sizeof(msg));
+		msg.msg_control    = ctrl.buf;
+		msg.msg_controllen = sizeof(ctrl.buf);
+
+		if (recvmsg(tc->fdc, &msg, MSG_ERRQUEUE | MSG_DONTWAIT) < 0)
+			break;
+
+		for (cmsg = CMSG_FIRSTHDR(&msg); cmsg;
+		     cmsg = CMSG_NXTHDR(&msg, cmsg)) {
+
+			struct sock_extended_err serr;
+
+			if (!(cmsg->cmsg_level == IPPROTO_IP &&
+			      cmsg->cmsg_type == IP_RECVERR) &&
+			    !(cmsg->cmsg_level == IPPROTO_IPV6 &&
+			      cmsg->cmsg_type == IPV6_RECVERR))
+				continue;
+
+			memcpy(&serr, CMSG_DATA(cmsg), sizeof(serr));
+
+			if (serr.ee_errno != 0 ||
+			    serr.ee_origin != SO_EE_ORIGIN_ZEROCOPY)
+				continue;
+
+			zc_release(tc, serr.ee_info, serr.ee_data);
+		}
+	}
+}
+#endif
+
+
+#ifndef WIN32
+/*
+ * Send from a vector of buffers with one system call. With zero-copy
+ * enabled, large sends pin the objects in objv until completion.
+ */
+static ssize_t conn_sendv(struct tcp_conn *tc, struct iovec *iov,
+			  void **objv, size_t cnt)
+{
+	struct msghdr msg;
 #ifdef MSG_NOSIGNAL
 	const int flags = MSG_NOSIGNAL; /* disable SIGPIPE signal */
 #else
 	const int flags = 0;
 #endif
+#ifdef TCP_ZEROCOPY
+	struct tcp_zcent *ze = NULL;
+	size_t i, len = 0;
+#endif
+	ssize_t n;
+
+	memset(&msg, 0, sizeof(msg));
+	msg.msg_iov    = iov;
+	msg.msg_iovlen = cnt;
+
+#ifdef TCP_ZEROCOPY
+	if (tc->zerocopy && objv) {
+
+		for (i=0; i<cnt; i++)
+			len += iov[i].iov_len;
+
+		if (len >= TCP_ZEROCOPY_MIN)
+			ze = mem_zalloc(sizeof(*ze) + cnt * sizeof(void *),
+					zcent_destructor);
+	}
+
+	if (ze) {
+		for (i=0; i<cnt; i++)
+			ze->objv[i] = mem_ref(objv[i]);
+
+		ze->n = cnt;
+
+		n = sendmsg(tc->fdc, &msg, flags | MSG_ZEROCOPY);
+
+		/* out of pinned memory, fall back to copying */
+		if (n < 0 && errno == ENOBUFS) {
+			mem_deref(ze);
+			return sendmsg(tc->fdc, &msg, flags);
+		}
+
+		if (n < 0) {
+			const int err = errno;
+
+			mem_deref(ze);
+			errno = err;
+		}
+		else {
+			ze->id = tc->zcid++;
+			list_append(&tc->zcl, &ze->le, ze);
+		}
+
+		return n;
+	}
+#else
+	(void)objv;
+#endif
+
+	n = sendmsg(tc->fdc, &msg, flags);
+
+	return n;
+}
+#endif
+
+
+static int dequeue(struct tcp_conn *tc)
+{
+	struct tcp_qent *qe = list_ledata(tc->sendq.head);
+#ifdef WIN32
+	const int flags = 0;
+#else
+	struct iovec iov[TCP_IOV_MAX];
+	void *objv[TCP_IOV_MAX];
+	struct le *le;
+	size_t cnt = 0;
+#endif
+	ssize_t n;
+
 	if (!qe) {
 		if (tc->sendh)
 			tc->sendh(tc->arg);
@@ -230,8 +489,22 @@ static int dequeue(struct tcp_conn *tc)
 		return 0;
 	}
 
+#ifdef WIN32
 	n = send(tc->fdc, BUF_CAST mbuf_buf(&qe->mb),
 		 qe->mb.end - qe->mb.pos, flags);
+#else
+	for (le = tc->sendq.head; le && cnt < TCP_IOV_MAX; le = le->next) {
+
+		qe = le->data;
+
+		iov[cnt].iov_base = mbuf_buf(&qe->mb);
+		iov[cnt].iov_len  = mbuf_get_left(&qe->mb);
+		objv[cnt] = qe->ref ? (void *)qe->ref : (void *)qe->mb.buf;
+		++cnt;
+	}
+
+	n = conn_sendv(tc, iov, objv, cnt);
+#endif
 	if (n < 0) {
 		if (EAGAIN == errno)
 			return 0;
@@ -242,11 +515,7 @@ static int dequeue(struct tcp_conn *tc)
 		return errno;
 	}
 
-	tc->txqsz  -= n;
-	qe->mb.pos += n;
-
-	if (qe->mb.pos >= qe->mb.end)
-		mem_deref(qe);
+	sendq_consume(tc, n);
 
 	return 0;
 }
@@ -257,6 +526,10 @@ static void conn_close(struct tcp_conn *tc, int err)
 	list_flush(&tc->sendq);
 	tc->txqsz = 0;
 
+#ifdef TCP_ZEROCOPY
+	list_flush(&tc->zcl);
+#endif
+
 	/* Stop polling */
 	if (tc->fdc >= 0) {
 		fd_close(tc->fdc);
@@ -269,13 +542,150 @@ static void conn_close(struct tcp_conn *tc, int err)
 }
 
 
-static void tcp_recv_handler(int flags, void *arg)
+static int conn_read(struct tcp_conn *tc)
 {
-	struct tcp_conn *tc = arg;
 	struct mbuf *mb = NULL;
 	bool hlp_estab = false;
 	struct le *le;
 	ssize_t n;
+	int err = 0;
+
+	mb = mbuf_alloc(tc->rxsz);
+	if (!mb)
+		return ENOMEM;
+
+	n = recv(tc->fdc, BUF_CAST mb->buf, mb->size, 0);
+	if (0 == n) {
+		mem_deref(mb);
+		conn_close(tc, 0);
+		return ENOTCONN;
+	}
+	else if (n < 0) {
+#ifdef WIN32
+		err = WSAGetLastError();
+		if (err == WSAEWOULDBLOCK) {
+			err = EAGAIN;
+			goto out;
+		}
+		DEBUG_WARNING("recv handler: recv(): %d\n", err);
+		if (err == WSAECONNRESET || err == WSAECONNABORTED) {
+			mem_deref(mb);
+			conn_close(tc, err);
+			return ENOTCONN;
+		}
+#else
+		err = errno;
+		if (EAGAIN == err)
+			goto out;
+#ifdef EWOULDBLOCK
+		if (EWOULDBLOCK == err) {
+			err = EAGAIN;
+			goto out;
+		}
+#endif
+		DEBUG_INFO("recv handler: recv(): %m\n", err);
+		mem_deref(mb);
+		conn_close(tc, err);
+		return ENOTCONN;
+#endif
+		goto out;
+	}
+
+	mb->end = n;
+
+	le = tc->helpers.head;
+	while (le) {
+		struct tcp_helper *th = le->data;
+		bool hdld = false;
+
+		le = le->next;
+
+		if (hlp_estab) {
+
+			hdld |= th->estabh(&err, tc->active, th->arg);
+			if (err) {
+				conn_close(tc, err);
+				goto out;
+			}
+		}
+
+		if (mb->pos < mb->end) {
+
+		        hdld |= th->recvh(&err, mb, &hlp_estab, th->arg);
+			if (err) {
+				conn_close(tc, err);
+				goto out;
+			}
+		}
+
+		if (hdld)
+			goto out;
+	}
+
+	mbuf_trim(mb);
+
+	if (hlp_estab && tc->estabh) {
+
+		uint32_t nrefs;
+
+		mem_ref(tc);
+
+		tc->estabh(tc->arg);
+
+		nrefs = mem_nrefs(tc);
+		mem_deref(tc);
+
+		/* check if connection was deref'ed from establish handler */
+		if (nrefs == 1) {
+			err = ECONNABORTED;
+			goto out;
+		}
+	}
+
+	if (mb->pos < mb->end && tc->recvh) {
+
+		uint32_t nrefs;
+
+		mem_ref(tc);
+
+		tc->recvh(mb, tc->arg);
+
+		nrefs = mem_nrefs(tc);
+		mem_deref(tc);
+
+		/* check if connection was deref'ed from receive handler */
+		if (nrefs == 1)
+			err = ECONNABORTED;
+	}
+
+ out:
+	mem_deref(mb);
+
+	return err;
+}
+
+
+/* Read up to rxbudget chunks, until the socket would block */
+static void conn_read_burst(struct tcp_conn *tc)
+{
+	uint32_t i;
+
+	for (i=0; i<tc->rxbudget; i++) {
+
+		/* on error the connection may be gone */
+		if (conn_read(tc))
+			break;
+
+		if (tc->fdc < 0)
+			break;
+	}
+}
+
+
+static void tcp_recv_handler(int flags, void *arg)
+{
+	struct tcp_conn *tc = arg;
+	struct le *le;
 	int err;
 	socklen_t err_len = sizeof(err);
 
@@ -283,23 +693,31 @@ static void tcp_recv_handler(int flags, void *arg)
 		DEBUG_INFO("recv handler: got FD_EXCEPT on fd=%d\n", tc->fdc);
 	}
 
-	/* check for any errors */
-	if (-1 == getsockopt(tc->fdc, SOL_SOCKET, SO_ERROR,
-			     BUF_CAST &err, &err_len)) {
-		DEBUG_WARNING("recv handler: getsockopt: (%m)\n", errno);
-		return;
-	}
+#ifdef TCP_ZEROCOPY
+	/* zero-copy completions are reported on the error queue */
+	if ((flags & FD_EXCEPT) && (tc->zerocopy || tc->zcl.head))
+		zc_complete(tc);
+#endif
 
-	if (err) {
-		conn_close(tc, err);
-		return;
-	}
-#if 0
-	if (EINPROGRESS != err && EALREADY != err) {
-		DEBUG_WARNING("recv handler: Socket error (%m)\n", err);
-		return;
+	/*
+	 * Check for socket errors only while connecting or on FD_EXCEPT.
+	 * On an established connection, errors are reported by recv()
+	 * and send().
+	 */
+	if (!tc->connected || (flags & FD_EXCEPT)) {
+
+		if (-1 == getsockopt(tc->fdc, SOL_SOCKET, SO_ERROR,
+				     BUF_CAST &err, &err_len)) {
+			DEBUG_WARNING("recv handler: getsockopt: (%m)\n",
+				      errno);
+			return;
+		}
+
+		if (err) {
+			conn_close(tc, err);
+			return;
+		}
 	}
-#endif
 
 	if (flags & FD_WRITE) {
 
@@ -368,86 +786,7 @@ static void tcp_recv_handler(int flags, void *arg)
 	}
 
  read:
-	mb = mbuf_alloc(tc->rxsz);
-	if (!mb)
-		return;
-
-	n = recv(tc->fdc, BUF_CAST mb->buf, mb->size, 0);
-	if (0 == n) {
-		mem_deref(mb);
-		conn_close(tc, 0);
-		return;
-	}
-	else if (n < 0) {
-#ifdef WIN32
-		err = WSAGetLastError();
-		DEBUG_WARNING("recv handler: recv(): %d\n", err);
-		if (err == WSAECONNRESET || err == WSAECONNABORTED) {
-			mem_deref(mb);
-			conn_close(tc, err);
-			return;
-		}
-#else
-		DEBUG_WARNING("recv handler: recv(): %m\n", errno);
-#endif
-		goto out;
-	}
-
-	mb->end = n;
-
-	le = tc->helpers.head;
-	while (le) {
-		struct tcp_helper *th = le->data;
-		bool hdld = false;
-
-		le = le->next;
-
-		if (hlp_estab) {
-
-			hdld |= th->estabh(&err, tc->active, th->arg);
-			if (err) {
-				conn_close(tc, err);
-				goto out;
-			}
-		}
-
-		if (mb->pos < mb->end) {
-
-		        hdld |= th->recvh(&err, mb, &hlp_estab, th->arg);
-			if (err) {
-				conn_close(tc, err);
-				goto out;
-			}
-		}
-
-		if (hdld)
-			goto out;
-	}
-
-	mbuf_trim(mb);
-
-	if (hlp_estab && tc->estabh) {
-
-		uint32_t nrefs;
-
-		mem_ref(tc);
-
-		tc->estabh(tc->arg);
-
-		nrefs = mem_nrefs(tc);
-		mem_deref(tc);
-
-		/* check if connection was deref'ed from establish handler */
-		if (nrefs == 1)
-			goto out;
-	}
-
-	if (mb->pos < mb->end && tc->recvh) {
-		tc->recvh(mb, tc->arg);
-	}
-
- out:
-	mem_deref(mb);
+	conn_read_burst(tc);
 }
 
 
@@ -464,6 +803,7 @@ static struct tcp_conn *conn_alloc(tcp_estab_h *eh, tcp_recv_h *rh,
 
 	tc->fdc    = -1;
 	tc->rxsz   = TCP_RXSZ_DEFAULT;
+	tc->rxbudget = TCP_RXBUDGET_DEFAULT;
 	tc->txqsz_max = TCP_TXQSZ_DEFAULT;
 	tc->estabh = eh;
 	tc->recvh  = rh;
@@ -514,26 +854,23 @@ static int  tcp_sock_setopt(struct tcp_sock *ts, int level, int optname,
 }
 
 
-/**
- * Handler for incoming TCP connections.
- *
- * @param flags  Event flags.
- * @param arg    Handler argument.
- */
-static void tcp_conn_handler(int flags, void *arg)
+/* Accept one connection, returns false if there was none */
+static bool conn_accept(struct tcp_sock *ts)
 {
 	struct sa peer;
-	struct tcp_sock *ts = arg;
 	int err;
 
-	(void)flags;
-
 	sa_init(&peer, AF_UNSPEC);
 
 	if (ts->fdc >= 0)
 		(void)close(ts->fdc);
 
+#ifdef TCP_ACCEPT4
+	ts->fdc = accept4(ts->fd, &peer.u.sa, &peer.len,
+			  SOCK_NONBLOCK | SOCK_CLOEXEC);
+#else
 	ts->fdc = SOK_CAST accept(ts->fd, &peer.u.sa, &peer.len);
+#endif
 	if (-1 == ts->fdc) {
 
 #if TARGET_OS_IPHONE
@@ -544,7 +881,7 @@ static void tcp_conn_handler(int flags, void *arg)
 
 			err = tcp_sock_local_get(ts, &laddr);
 			if (err)
-				return;
+				return false;
 
 			if (ts->fd >= 0) {
 				fd_close(ts->fd);
@@ -554,7 +891,7 @@ static void tcp_conn_handler(int flags, void *arg)
 
 			err = tcp_listen(&ts_new, &laddr, NULL, NULL);
 			if (err)
-				return;
+				return false;
 
 			ts->fd = ts_new->fd;
 			ts_new->fd = -1;
@@ -565,21 +902,58 @@ static void tcp_conn_handler(int flags, void *arg)
 		}
 #endif
 
-		return;
+		return false;
 	}
 
+#ifndef TCP_ACCEPT4
+	/* with accept4() the options are inherited from the listener */
 	err = net_sockopt_blocking_set(ts->fdc, false);
 	if (err) {
 		DEBUG_WARNING("conn handler: nonblock set: %m\n", err);
 		(void)close(ts->fdc);
 		ts->fdc = -1;
-		return;
+		return true;
 	}
 
 	tcp_sockopt_set(ts->fdc);
+#else
+	(void)err;
+#endif
 
 	if (ts->connh)
 		ts->connh(&peer, ts->arg);
+
+	return true;
+}
+
+
+/**
+ * Handler for incoming TCP connections. Up to acceptbudget pending
+ * connections are accepted per call.
+ *
+ * @param flags  Event flags.
+ * @param arg    Handler argument.
+ */
+static void tcp_conn_handler(int flags, void *arg)
+{
+	struct tcp_sock *ts = arg;
+	uint32_t i;
+
+	(void)flags;
+
+	mem_ref(ts);
+
+	for (i=0; i<ts->acceptbudget; i++) {
+
+		if (!conn_accept(ts))
+			break;
+
+		/* socket was deref'd or closed from the connect handler */
+		if (mem_nrefs(ts) == 1 || ts->fd < 0)
+			break;
+	}
+
+	mem_deref(ts);
 }
 
 
@@ -611,6 +985,7 @@ int tcp_sock_alloc(struct tcp_sock **tsp, const struct sa *local,
 
 	ts->fd  = -1;
 	ts->fdc = -1;
+	ts->acceptbudget = TCP_ACCEPTBUDGET_DEFAULT;
 
 	if (local) {
 		(void)re_snprintf(addr, sizeof(addr), "%H",
@@ -1111,8 +1486,14 @@ int tcp_conn_connect(struct tcp_conn *tc, const struct sa *peer)
 }
 
 
+/*
+ * Buffers are only queued by reference or pinned for zero-copy when byref
+ * is set, i.e. for buffers that come directly from the application. Send
+ * helpers may pass buffers that they do not own, e.g. the TLS BIO passes
+ * a stack mbuf with data inside the TLS library, so those are copied.
+ */
 static int tcp_send_internal(struct tcp_conn *tc, struct mbuf *mb,
-			     struct le *le)
+			     struct le *le, bool byref)
 {
 	int err = 0;
 	ssize_t n;
@@ -1141,6 +1522,30 @@ static int tcp_send_internal(struct tcp_conn *tc, struct mbuf *mb,
 			return err;
 	}
 
+#ifdef TCP_ZEROCOPY
+	/* with zero-copy the buffer is not modified by the caller */
+	if (tc->zerocopy && byref) {
+		struct iovec iov;
+		void *obj = mb;
+
+		if (tc->sendq.head)
+			return enqueue_ref(tc, mb, mb->pos);
+
+		iov.iov_base = mbuf_buf(mb);
+		iov.iov_len  = mbuf_get_left(mb);
+
+		n = conn_sendv(tc, &iov, &obj, 1);
+		if (n < 0 && (EAGAIN == errno || EWOULDBLOCK == errno))
+			return enqueue_ref(tc, mb, mb->pos);
+		else if (n < 0)
+			return errno;
+		else if ((size_t)n < mbuf_get_left(mb))
+			return enqueue_ref(tc, mb, mb->pos + n);
+
+		return 0;
+	}
+#endif
+
 	if (tc->sendq.head)
 		return enqueue(tc, mb);
 
@@ -1191,7 +1596,120 @@ int tcp_send(struct tcp_conn *tc, struct mbuf *mb)
 	if (!tc || !mb)
 		return EINVAL;
 
-	return tcp_send_internal(tc, mb, tc->helpers.tail);
+	return tcp_send_internal(tc, mb, tc->helpers.tail,
+				 !tc->helpers.head);
+}
+
+
+/**
+ * Send data from a vector of buffers on a TCP Connection to a remote peer,
+ * e.g. a header and a body, without concatenating them. The buffers are
+ * sent with one system call, and unsent data is queued by reference, so
+ * the buffers must not be modified after this call. If the connection has
+ * send helpers, each buffer is passed to them as with tcp_send().
+ *
+ * @param tc  TCP Connection
+ * @param mbv Vector of buffers to send
+ * @param n   Number of buffers
+ *
+ * @return 0 if success, otherwise errorcode
+ */
+int tcp_send_vec(struct tcp_conn *tc, struct mbuf **mbv, size_t n)
+{
+	size_t i, total = 0, sent = 0;
+	int err = 0;
+
+	if (!tc || !mbv || !n)
+		return EINVAL;
+
+	if (tc->fdc < 0)
+		return ENOTCONN;
+
+	for (i=0; i<n; i++) {
+		if (!mbv[i])
+			return EINVAL;
+
+		total += mbuf_get_left(mbv[i]);
+	}
+
+	if (!total)
+		return EINVAL;
+
+	if (tc->helpers.head) {
+
+		for (i=0; i<n; i++) {
+
+			if (!mbuf_get_left(mbv[i]))
+				continue;
+
+			err = tcp_send_internal(tc, mbv[i], tc->helpers.tail,
+						false);
+			if (err)
+				return err;
+		}
+
+		return 0;
+	}
+
+	/* never send a part of the vector that can not be queued */
+	if (tc->txqsz + total > tc->txqsz_max)
+		return ENOSPC;
+
+#ifndef WIN32
+	if (!tc->sendq.head) {
+		struct iovec iov[TCP_IOV_MAX];
+		void *objv[TCP_IOV_MAX];
+		size_t cnt = 0;
+		ssize_t r;
+
+		for (i=0; i<n && cnt < TCP_IOV_MAX; i++) {
+
+			if (!mbuf_get_left(mbv[i]))
+				continue;
+
+			iov[cnt].iov_base = mbuf_buf(mbv[i]);
+			iov[cnt].iov_len  = mbuf_get_left(mbv[i]);
+			objv[cnt] = mbv[i];
+			++cnt;
+		}
+
+		r = conn_sendv(tc, iov, objv, cnt);
+		if (r < 0) {
+			err = errno;
+
+			if (EAGAIN != err && EWOULDBLOCK != err) {
+				DEBUG_WARNING("send: sendmsg(): %m (fdc=%d)\n",
+					      err, tc->fdc);
+				return err;
+			}
+
+			err = 0;
+			r = 0;
+		}
+
+		sent = r;
+		if (sent == total)
+			return 0;
+	}
+#endif
+
+	for (i=0; i<n; i++) {
+		struct mbuf *mb = mbv[i];
+		const size_t len = mbuf_get_left(mb);
+
+		if (sent >= len) {
+			sent -= len;
+			continue;
+		}
+
+		err = enqueue_ref(tc, mb, mb->pos + sent);
+		if (err)
+			break;
+
+		sent = 0;
+	}
+
+	return err;
 }
 
 
@@ -1211,7 +1729,7 @@ int tcp_send_helper(struct tcp_conn *tc, struct mbuf *mb,
 	if (!tc || !mb || !th)
 		return EINVAL;
 
-	return tcp_send_internal(tc, mb, th->le.prev);
+	return tcp_send_internal(tc, mb, th->le.prev, false);
 }
 
 
@@ -1347,6 +1865,22 @@ void tcp_conn_rxsz_set(struct tcp_conn *tc, size_t rxsz)
 }
 
 
+/**
+ * Set the maximum number of chunks read per receive event. A budget larger
+ * than one keeps reading until the socket would block or the budget is used.
+ *
+ * @param tc     TCP Connection
+ * @param budget Maximum number of receive chunks per event
+ */
+void tcp_conn_rxbudget_set(struct tcp_conn *tc, uint32_t budget)
+{
+	if (!tc)
+		return;
+
+	tc->rxbudget = budget ? budget : TCP_RXBUDGET_DEFAULT;
+}
+
+
 /**
  * Set the maximum send queue size on a TCP Connection
  *
@@ -1388,6 +1922,47 @@ size_t tcp_conn_txqsz(const struct tcp_conn *tc)
 }
 
 
+/**
+ * Enable or disable zero-copy sending (MSG_ZEROCOPY) on a TCP Connection.
+ * Large sends are then not copied into the kernel, and the buffers are
+ * referenced until the kernel reports that it is done with them. While
+ * enabled, buffers passed to tcp_send() are referenced as with
+ * tcp_send_vec(), and must not be modified after the call. Buffers that
+ * are still pinned when the connection is closed are released then.
+ * Zero-copy only applies while the connection has no send helpers (e.g.
+ * TLS); data passed through helpers is always copied.
+ *
+ * @param tc     TCP Connection
+ * @param enable True to enable, false to disable
+ *
+ * @return 0 if success, ENOSYS if not supported, otherwise errorcode
+ */
+int tcp_conn_zerocopy_set(struct tcp_conn *tc, bool enable)
+{
+#ifdef TCP_ZEROCOPY
+	int v = 1;
+
+	if (!tc)
+		return EINVAL;
+
+	if (tc->fdc < 0)
+		return ENOTCONN;
+
+	if (enable && 0 != setsockopt(tc->fdc, SOL_SOCKET, SO_ZEROCOPY,
+				      &v, sizeof(v)))
+		return errno == ENOPROTOOPT ? ENOSYS : errno;
+
+	tc->zerocopy = enable;
+
+	return 0;
+#else
+	(void)enable;
+
+	return tc ? ENOSYS : EINVAL;
+#endif
+}
+
+
 static bool sort_handler(struct le *le1, struct le *le2, void *arg)
 {
 	struct tcp_helper *th1 = le1->data, *th2 = le2->data;
@@ -1456,6 +2031,74 @@ int tcp_settos(struct tcp_sock *ts, uint32_t tos)
 }
 
 
+/**
+ * Share the local port of a TCP Socket with other sockets (SO_REUSEPORT).
+ * Must be called before tcp_sock_bind()
+ *
+ * @param ts     TCP Socket
+ * @param reuse  true for reuse, false for no reuse
+ *
+ * @return 0 if success, otherwise errorcode
+ */
+int tcp_sock_reuseport_set(struct tcp_sock *ts, bool reuse)
+{
+	if (!ts || ts->fd < 0)
+		return EINVAL;
+
+	return net_sockopt_reuseport_set(ts->fd, reuse);
+}
+
+
+/**
+ * Set the maximum number of connections accepted per event on a TCP
+ * Socket. The connect handler is called once for each connection.
+ *
+ * @param ts     TCP Socket
+ * @param budget Maximum number of connections per event
+ */
+void tcp_sock_acceptbudget_set(struct tcp_sock *ts, uint32_t budget)
+{
+	if (!ts)
+		return;
+
+	ts->acceptbudget = budget ? budget : TCP_ACCEPTBUDGET_DEFAULT;
+}
+
+
+/**
+ * Defer accepting connections on a TCP Socket until data has arrived
+ * (TCP_DEFER_ACCEPT), for protocols where the client sends first, such
+ * as SIP and TLS.
+ *
+ * @param ts      TCP Socket
+ * @param timeout Seconds to wait for data, 0 to disable
+ *
+ * @return 0 if success, ENOSYS if not supported, otherwise errorcode
+ */
+int tcp_sock_defer_accept_set(struct tcp_sock *ts, uint32_t timeout)
+{
+#ifdef TCP_DEFER_ACCEPT
+	int v = (int)timeout;
+
+	if (!ts)
+		return EINVAL;
+
+	if (ts->fd < 0)
+		return EBADF;
+
+	if (0 != setsockopt(ts->fd, IPPROTO_TCP, TCP_DEFER_ACCEPT,
+			    BUF_CAST &v, sizeof(v)))
+		return errno;
+
+	return 0;
+#else
+	(void)timeout;
+
+	return ts ? ENOSYS : EINVAL;
+#endif
+}
+
+
 int tcp_conn_settos(struct tcp_conn *tc, uint32_t tos)
 {
 	int err = 0;
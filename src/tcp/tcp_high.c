@@ -6,21 +6,12 @@
 #include <re_types.h>
 #include <re_mem.h>
 #include <re_mbuf.h>
+#include <re_sa.h>
 #include <re_tcp.h>
 
 
-/**
- * Create and listen on a TCP Socket
- *
- * @param tsp   Pointer to returned TCP Socket
- * @param local Local listen address (NULL for any)
- * @param ch    Incoming connection handler
- * @param arg   Handler argument
- *
- * @return 0 if success, otherwise errorcode
- */
-int tcp_listen(struct tcp_sock **tsp, const struct sa *local,
-	       tcp_conn_h *ch, void *arg)
+static int listen_internal(struct tcp_sock **tsp, const struct sa *local,
+			   tcp_conn_h *ch, void *arg, bool reuseport)
 {
 	struct tcp_sock *ts = NULL;
 	int err;
@@ -32,6 +23,12 @@ int tcp_listen(struct tcp_sock **tsp, const struct sa *local,
 	if (err)
 		goto out;
 
+	if (reuseport) {
+		err = tcp_sock_reuseport_set(ts, true);
+		if (err)
+			goto out;
+	}
+
 	err = tcp_sock_bind(ts, local);
 	if (err)
 		goto out;
@@ -50,6 +47,44 @@ int tcp_listen(struct tcp_sock **tsp, const struct sa *local,
 }
 
 
+/**
+ * Create and listen on a TCP Socket
+ *
+ * @param tsp   Pointer to returned TCP Socket
+ * @param local Local listen address (NULL for any)
+ * @param ch    Incoming connection handler
+ * @param arg   Handler argument
+ *
+ * @return 0 if success, otherwise errorcode
+ */
+int tcp_listen(struct tcp_sock **tsp, const struct sa *local,
+	       tcp_conn_h *ch, void *arg)
+{
+	return listen_internal(tsp, local, ch, arg, false);
+}
+
+
+/**
+ * Create and listen on a TCP Socket that shares its local address with
+ * other sockets (SO_REUSEPORT), e.g. one per worker of a re_pool
+ *
+ * @param tsp   Pointer to returned TCP Socket
+ * @param local Local listen address, with a fixed port
+ * @param ch    Incoming connection handler
+ * @param arg   Handler argument
+ *
+ * @return 0 if success, otherwise errorcode
+ */
+int tcp_listen_reuseport(struct tcp_sock **tsp, const struct sa *local,
+			 tcp_conn_h *ch, void *arg)
+{
+	if (!local || !sa_port(local))
+		return EINVAL;
+
+	return listen_internal(tsp, local, ch, arg, true);
+}
+
+
 /**
  * Make a TCP Connection to a remote peer
  *
@@ -10,9 +10,6 @@
 #endif
 
 #include <string.h>
-#ifdef HAVE_SYS_TIME_H
-#include <sys/time.h>
-#endif
 #ifdef WIN32
 #include <windows.h>
 #else
@@ -22,6 +19,10 @@
 #include <stdlib.h>
 #include <pthread.h>
 #endif
+#if defined(HAVE_ATOMIC) && !defined(__STDC_NO_ATOMICS__)
+#include <stdatomic.h>
+#define TMR_CLOCK_ATOMIC 1  /**< Clock settings shared between threads */
+#endif
 #include <re_types.h>
 #include <re_list.h>
 #include <re_fmt.h>
@@ -36,27 +37,198 @@
 
 /** Timer values */
 enum {
-	MAX_BLOCKING = 500   /**< Maximum time spent in handler [ms] */
+	MAX_BLOCKING = 500,  /**< Maximum time spent in handler [ms] */
+	HEAP_MINSZ   = 64    /**< Initial size of the timer heap     */
+};
+
+
+/** Binary min-heap of running timers, ordered by expiry */
+struct tmrh {
+	struct tmr **v;      /**< Heap array                   */
+	uint32_t n;          /**< Number of timers in the heap */
+	uint32_t sz;         /**< Allocated size of heap array */
+	uint64_t seq;        /**< Start sequence counter       */
+	uint64_t jfs;        /**< Cached jiffies of this loop  */
 };
 
 extern struct list *tmrl_get(void);
+extern struct tmrh **tmrh_get(void);
+
+#ifdef TMR_CLOCK_ATOMIC
+static _Atomic enum tmr_clock clock_mode = TMR_CLOCK_MONOTONIC;
+static atomic_bool clock_cache = false;
+#define CLOCK_GET(var) \
+	atomic_load_explicit(&(var), memory_order_relaxed)
+#define CLOCK_SET(var, val) \
+	atomic_store_explicit(&(var), (val), memory_order_relaxed)
+#else
+static enum tmr_clock clock_mode = TMR_CLOCK_MONOTONIC;
+static bool clock_cache = false;
+#define CLOCK_GET(var)      (var)
+#define CLOCK_SET(var, val) ((var) = (val))
+#endif
 
 
-static bool inspos_handler(struct le *le, void *arg)
+static void heap_destructor(void *arg)
 {
-	struct tmr *tmr = le->data;
-	const uint64_t now = *(uint64_t *)arg;
+	struct tmrh *h = arg;
 
-	return tmr->jfs <= now;
+	mem_deref(h->v);
 }
 
 
-static bool inspos_handler_0(struct le *le, void *arg)
+static inline bool heap_less(const struct tmr *a, const struct tmr *b)
 {
-	struct tmr *tmr = le->data;
-	const uint64_t now = *(uint64_t *)arg;
+	if (a->jfs != b->jfs)
+		return a->jfs < b->jfs;
+
+	/* timers with equal expiry fire in the order they were started */
+	return a->seq < b->seq;
+}
 
-	return tmr->jfs > now;
+
+static inline void heap_set(struct tmrh *h, uint32_t i, struct tmr *tmr)
+{
+	h->v[i]  = tmr;
+	tmr->idx = i;
+}
+
+
+static void heap_sift_up(struct tmrh *h, uint32_t i)
+{
+	struct tmr *tmr = h->v[i];
+
+	while (i > 0) {
+		const uint32_t parent = (i - 1) / 2;
+
+		if (!heap_less(tmr, h->v[parent]))
+			break;
+
+		heap_set(h, i, h->v[parent]);
+		i = parent;
+	}
+
+	heap_set(h, i, tmr);
+}
+
+
+static void heap_sift_down(struct tmrh *h, uint32_t i)
+{
+	struct tmr *tmr = h->v[i];
+
+	for (;;) {
+		uint32_t child = 2*i + 1;
+
+		if (child >= h->n)
+			break;
+
+		if (child + 1 < h->n && heap_less(h->v[child+1], h->v[child]))
+			++child;
+
+		if (!heap_less(h->v[child], tmr))
+			break;
+
+		heap_set(h, i, h->v[child]);
+		i = child;
+	}
+
+	heap_set(h, i, tmr);
+}
+
+
+static struct tmrh *heap_get(struct tmrh **hp)
+{
+	if (!*hp)
+		*hp = mem_zalloc(sizeof(struct tmrh), heap_destructor);
+
+	return *hp;
+}
+
+
+static int heap_insert(struct tmrh **hp, struct tmr *tmr)
+{
+	struct tmrh *h = heap_get(hp);
+
+	if (!h)
+		return ENOMEM;
+
+	if (h->n >= h->sz) {
+		const uint32_t sz = h->sz ? h->sz * 2 : HEAP_MINSZ;
+		struct tmr **v;
+
+		v = mem_reallocarray(h->v, sz, sizeof(*v), NULL);
+		if (!v)
+			return ENOMEM;
+
+		h->v  = v;
+		h->sz = sz;
+	}
+
+	tmr->seq  = h->seq++;
+	tmr->tmrh = h;
+
+	heap_set(h, h->n++, tmr);
+	heap_sift_up(h, tmr->idx);
+
+	return 0;
+}
+
+
+/* The timer is removed from the heap it was inserted into, which may
+ * belong to another thread's loop */
+static void heap_remove(struct tmr *tmr)
+{
+	struct tmrh *h = tmr->tmrh;
+	const uint32_t i = tmr->idx;
+	struct tmr *last;
+
+	if (!h)
+		return;
+
+	tmr->tmrh = NULL;
+
+	if (i >= h->n || h->v[i] != tmr)
+		return;
+
+	last = h->v[--h->n];
+	if (last == tmr)
+		return;
+
+	heap_set(h, i, last);
+
+	if (i > 0 && heap_less(last, h->v[(i - 1) / 2]))
+		heap_sift_up(h, i);
+	else
+		heap_sift_down(h, i);
+}
+
+
+static inline struct tmr *heap_min(const struct tmrh *h)
+{
+	return (h && h->n) ? h->v[0] : NULL;
+}
+
+
+/*
+ * Slow path: timers that could not be inserted into the heap, because it
+ * could not grow, are kept unsorted at the head of the timer list.
+ */
+static inline struct tmr *ovfl_head(const struct list *tmrl)
+{
+	struct le *le = list_head(tmrl);
+	struct tmr *tmr = le ? le->data : NULL;
+
+	return (tmr && !tmr->tmrh) ? tmr : NULL;
+}
+
+
+/* Current jiffies, from the loop cache if enabled */
+static inline uint64_t jiffies_now(const struct tmrh *h)
+{
+	if (CLOCK_GET(clock_cache) && h && h->jfs)
+		return h->jfs;
+
+	return tmr_jiffies();
 }
 
 
@@ -79,6 +251,52 @@ static void call_handler(tmr_h *th, void *arg)
 #endif
 
 
+static void ovfl_poll(struct list *tmrl, struct tmrh **hp, uint64_t jfs)
+{
+	struct le *le = list_head(tmrl);
+
+	while (le) {
+		struct tmr *tmr = le->data;
+		tmr_h *th;
+		void *th_arg;
+
+		if (tmr->tmrh)
+			break;
+
+		le = le->next;
+
+		if (tmr->jfs > jfs) {
+
+			/* move the timer to the heap, if it can grow now */
+			if (!heap_insert(hp, tmr)) {
+				list_unlink(&tmr->le);
+				list_append(tmrl, &tmr->le, tmr);
+			}
+
+			continue;
+		}
+
+		th = tmr->th;
+		th_arg = tmr->arg;
+
+		tmr->th = NULL;
+
+		list_unlink(&tmr->le);
+
+		if (th) {
+#if TMR_DEBUG
+			call_handler(th, th_arg);
+#else
+			th(th_arg);
+#endif
+		}
+
+		/* the handler may have changed the list */
+		le = list_head(tmrl);
+	}
+}
+
+
 /**
  * Poll all timers in the current thread
  *
@@ -86,14 +304,20 @@ static void call_handler(tmr_h *th, void *arg)
  */
 void tmr_poll(struct list *tmrl)
 {
-	const uint64_t jfs = tmr_jiffies();
+	struct tmrh **hp = tmrh_get();
+	uint64_t jfs;
+
+	if (list_isempty(tmrl))
+		return;
+
+	jfs = jiffies_now(*hp);
 
 	for (;;) {
 		struct tmr *tmr;
 		tmr_h *th;
 		void *th_arg;
 
-		tmr = list_ledata(tmrl->head);
+		tmr = heap_min(*hp);
 
 		if (!tmr || (tmr->jfs > jfs)) {
 			break;
@@ -104,6 +328,7 @@ void tmr_poll(struct list *tmrl)
 
 		tmr->th = NULL;
 
+		heap_remove(tmr);
 		list_unlink(&tmr->le);
 
 		if (!th)
@@ -115,6 +340,9 @@ void tmr_poll(struct list *tmrl)
 		th(th_arg);
 #endif
 	}
+
+	if (ovfl_head(tmrl))
+		ovfl_poll(tmrl, hp, jfs);
 }
 
 
@@ -160,7 +388,7 @@ uint64_t tmr_jiffies_usec(void)
 
 
 /**
- * Get the timer jiffies in milliseconds
+ * Get the timer jiffies in milliseconds, from a monotonic clock
  *
  * @return Jiffies in [ms]
  */
@@ -169,28 +397,89 @@ uint64_t tmr_jiffies(void)
 	uint64_t jfs;
 
 #if defined(WIN32)
-	FILETIME ft;
-	ULARGE_INTEGER li;
-	GetSystemTimeAsFileTime(&ft);
-	li.LowPart = ft.dwLowDateTime;
-	li.HighPart = ft.dwHighDateTime;
-	jfs = li.QuadPart/10/1000;
+	jfs = tmr_jiffies_usec() / 1000;
 #else
-	struct timeval now;
+	struct timespec now;
+	clockid_t id = CLOCK_MONOTONIC;
 
-	if (0 != gettimeofday(&now, NULL)) {
-		DEBUG_WARNING("jiffies: gettimeofday() failed (%m)\n", errno);
+#ifdef CLOCK_MONOTONIC_COARSE
+	if (CLOCK_GET(clock_mode) == TMR_CLOCK_COARSE)
+		id = CLOCK_MONOTONIC_COARSE;
+#endif
+
+	if (0 != clock_gettime(id, &now)) {
+		DEBUG_WARNING("jiffies: clock_gettime() failed (%m)\n", errno);
 		return 0;
 	}
 
 	jfs  = (long)now.tv_sec * (uint64_t)1000;
-	jfs += now.tv_usec / 1000;
+	jfs += now.tv_nsec / 1000000;
 #endif
 
 	return jfs;
 }
 
 
+/**
+ * Get the cached timer jiffies of the current thread's main loop. The
+ * value is refreshed once per loop iteration by re_main(), or explicitly
+ * with tmr_jiffies_update().
+ *
+ * @return Jiffies in [ms]
+ */
+uint64_t tmr_jiffies_cached(void)
+{
+	const struct tmrh *h = *tmrh_get();
+
+	return (h && h->jfs) ? h->jfs : tmr_jiffies();
+}
+
+
+/**
+ * Refresh the cached timer jiffies of the current thread
+ *
+ * @return Jiffies in [ms]
+ */
+uint64_t tmr_jiffies_update(void)
+{
+	struct tmrh *h = heap_get(tmrh_get());
+	const uint64_t jfs = tmr_jiffies();
+
+	if (h)
+		h->jfs = jfs;
+
+	return jfs;
+}
+
+
+/**
+ * Set the clock source used for timer jiffies
+ *
+ * The setting is process-wide. Without C11 atomics (HAVE_ATOMIC) it must
+ * be changed before other threads run their main loops.
+ *
+ * @param clk Timer clock source
+ */
+void tmr_clock_set(enum tmr_clock clk)
+{
+	CLOCK_SET(clock_mode, clk);
+}
+
+
+/**
+ * Enable or disable use of the cached loop jiffies for timers. When enabled,
+ * tmr_start(), tmr_poll() and tmr_get_expire() use the time taken after the
+ * last wakeup of the main loop instead of reading the clock on every call.
+ * Like tmr_clock_set() the setting applies to all threads.
+ *
+ * @param enable True to enable, false to disable
+ */
+void tmr_clock_cache(bool enable)
+{
+	CLOCK_SET(clock_cache, enable);
+}
+
+
 /**
  * Get number of milliseconds until the next timer expires
  *
@@ -200,13 +489,35 @@ uint64_t tmr_jiffies(void)
  */
 uint64_t tmr_next_timeout(struct list *tmrl)
 {
-	const uint64_t jif = tmr_jiffies();
+	struct tmrh *h = *tmrh_get();
 	const struct tmr *tmr;
+	struct le *le;
+	uint64_t jif;
+
+	if (list_isempty(tmrl))
+		return 0;
+
+	tmr = heap_min(h);
+
+	/* timers outside the heap are at the head of the list */
+	for (le = list_head(tmrl); le; le = le->next) {
+		const struct tmr *t = le->data;
+
+		if (t->tmrh)
+			break;
+
+		if (!tmr || t->jfs < tmr->jfs)
+			tmr = t;
+	}
 
-	tmr = list_ledata(tmrl->head);
 	if (!tmr)
 		return 0;
 
+	/* always read the clock here, to not oversleep on a stale cache */
+	jif = tmr_jiffies();
+	if (h)
+		h->jfs = jif;
+
 	if (tmr->jfs <= jif)
 		return 1;
 	else
@@ -278,13 +589,16 @@ void tmr_init(struct tmr *tmr)
  */
 void tmr_start(struct tmr *tmr, uint64_t delay, tmr_h *th, void *arg)
 {
-	struct list *tmrl = tmrl_get();
-	struct le *le;
+	struct tmrh **hp;
+	int err;
 
 	if (!tmr)
 		return;
 
+	hp = tmrh_get();
+
 	if (tmr->th) {
+		heap_remove(tmr);
 		list_unlink(&tmr->le);
 	}
 
@@ -294,26 +608,18 @@ void tmr_start(struct tmr *tmr, uint64_t delay, tmr_h *th, void *arg)
 	if (!th)
 		return;
 
-	tmr->jfs = delay + tmr_jiffies();
+	tmr->jfs = delay + jiffies_now(*hp);
 
-	if (delay == 0) {
-		le = list_apply(tmrl, true, inspos_handler_0, &tmr->jfs);
-		if (le) {
-			list_insert_before(tmrl, le, &tmr->le, tmr);
-		}
-		else {
-			list_append(tmrl, &tmr->le, tmr);
-		}
-	}
-	else {
-		le = list_apply(tmrl, false, inspos_handler, &tmr->jfs);
-		if (le) {
-			list_insert_after(tmrl, le, &tmr->le, tmr);
-		}
-		else {
-			list_prepend(tmrl, &tmr->le, tmr);
-		}
+	err = heap_insert(hp, tmr);
+	if (err) {
+		DEBUG_WARNING("start: timer heap insert failed,"
+			      " using slow path (%m)\n", err);
+		tmr->tmrh = NULL;
+		list_prepend(tmrl_get(), &tmr->le, tmr);
+		return;
 	}
+
+	list_append(tmrl_get(), &tmr->le, tmr);
 }
 
 
@@ -342,7 +648,7 @@ uint64_t tmr_get_expire(const struct tmr *tmr)
 	if (!tmr || !tmr->th)
 		return 0;
 
-	jfs = tmr_jiffies();
+	jfs = jiffies_now(*tmrh_get());
 
 	return (tmr->jfs > jfs) ? (tmr->jfs - jfs) : 0;
 }
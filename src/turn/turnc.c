@@ -320,7 +320,7 @@ static bool udp_recv_handler(struct sa *src, struct mbuf *mb, void *arg)
 	    !sa_cmp(&turnc->psrv, src, SA_ALL))
 		return false;
 
-	if (stun_msg_decode(&msg, mb, &ua)) {
+	if (!stun_msg_detect(mb) || stun_msg_decode(&msg, mb, &ua)) {
 
 		struct chan_hdr hdr;
 		struct chan *chan;
@@ -563,7 +563,7 @@ int turnc_recv(struct turnc *turnc, struct sa *src, struct mbuf *mb)
 	if (!turnc || !src || !mb)
 		return EINVAL;
 
-	if (stun_msg_decode(&msg, mb, &ua)) {
+	if (!stun_msg_detect(mb) || stun_msg_decode(&msg, mb, &ua)) {
 
 		struct chan_hdr hdr;
 		struct chan *chan;
@@ -3,6 +3,9 @@
  *
  * Copyright (C) 2010 Creytiv.com
  */
+#ifdef LINUX
+#define _GNU_SOURCE 1  /**< recvmmsg() and sendmmsg() */
+#endif
 #include <stdlib.h>
 #ifdef HAVE_UNISTD_H
 #include <unistd.h>
@@ -22,6 +25,19 @@
 #ifdef __APPLE__
 #include "TargetConditionals.h"
 #endif
+#ifdef LINUX
+#include <sys/socket.h>
+#define UDP_RECVMMSG 1  /**< Batched receive */
+#define UDP_SENDMMSG 1  /**< Batched send    */
+#include <netinet/udp.h>
+#if defined(UDP_SEGMENT) && defined(UDP_GRO)
+#define UDP_OFFLOAD 1   /**< Segmentation offload (GSO/GRO) */
+#endif
+#ifdef SO_TIMESTAMPNS
+#include <time.h>
+#define UDP_TSTAMP 1    /**< Kernel receive timestamps */
+#endif
+#endif
 #include <re_types.h>
 #include <re_fmt.h>
 #include <re_mem.h>
@@ -52,7 +68,13 @@
 
 
 enum {
-	UDP_RXSZ_DEFAULT = 8192
+	UDP_RXSZ_DEFAULT = 8192,
+	UDP_RXBUDGET_DEFAULT = 1,
+	UDP_RXBATCH_MAX = 32,
+	UDP_TXBATCH_MAX = 64,
+	UDP_GSO_SEGS_MAX = 64,
+	UDP_GSO_BYTES_MAX = 65000,
+	UDP_GRO_BUFSZ = 65535
 };
 
 
@@ -67,6 +89,28 @@ struct udp_sock {
 	bool conn;           /**< Connected socket flag       */
 	size_t rxsz;         /**< Maximum receive chunk size  */
 	size_t rx_presz;     /**< Preallocated rx buffer size */
+	uint32_t rxbudget;   /**< Max datagrams read per event */
+	bool edge;           /**< fd is polled edge-triggered  */
+	bool edge6;          /**< fd6 is polled edge-triggered */
+	struct mbuf **rxpoolv; /**< Recycled receive buffers  */
+	uint32_t rxpooln;    /**< Number of pooled buffers    */
+	uint32_t rxpoolsz;   /**< Maximum pooled buffers      */
+	uint64_t rxpool_hits;   /**< Buffers taken from pool  */
+	uint64_t rxpool_misses; /**< Buffers allocated        */
+	uint32_t rxpool_kept;   /**< Kept buffers to replace  */
+#ifdef UDP_RECVMMSG
+	struct mbuf **rxmbv; /**< Preallocated batch buffers  */
+#endif
+#ifdef UDP_OFFLOAD
+	uint8_t *grobuf;     /**< Receive buffer for GRO      */
+	bool gso;            /**< Segmentation offload on send */
+	bool gro;            /**< Coalesced receive enabled   */
+#endif
+#ifdef UDP_TSTAMP
+	bool tstamp;         /**< Kernel receive timestamps   */
+	int64_t tsoff;       /**< Realtime to monotonic [us]  */
+#endif
+	uint64_t rx_ts;      /**< Arrival time of datagram [us] */
 };
 
 /** Defines a UDP helper */
@@ -115,6 +159,25 @@ static void udp_destructor(void *data)
 
 	list_flush(&us->helpers);
 
+	while (us->rxpooln)
+		mem_deref(us->rxpoolv[--us->rxpooln]);
+	mem_deref(us->rxpoolv);
+
+#ifdef UDP_RECVMMSG
+	if (us->rxmbv) {
+		uint32_t i;
+
+		for (i=0; i<UDP_RXBATCH_MAX; i++)
+			mem_deref(us->rxmbv[i]);
+
+		mem_deref(us->rxmbv);
+	}
+#endif
+
+#ifdef UDP_OFFLOAD
+	mem_deref(us->grobuf);
+#endif
+
 	if (-1 != us->fd) {
 		fd_close(us->fd);
 		(void)close(us->fd);
@@ -127,18 +190,174 @@ static void udp_destructor(void *data)
 }
 
 
-static void udp_read(struct udp_sock *us, int fd)
+static void udp_recv_dispatch(struct udp_sock *us, struct sa *src,
+			      struct mbuf *mb)
 {
-	struct mbuf *mb = mbuf_alloc(us->rxsz);
-	struct sa src;
 	struct le *le;
+
+	/* call helpers */
+	le = us->helpers.head;
+	while (le) {
+		struct udp_helper *uh = le->data;
+		bool hdld;
+
+		le = le->next;
+
+		hdld = uh->recvh(src, mb, uh->arg);
+		if (hdld)
+			return;
+	}
+
+	us->rh(src, mb, us->arg);
+}
+
+
+/*
+ * Receive buffers are taken from the pool of the socket, if enabled, and
+ * returned to it if the handlers did not keep a reference. Pooled buffers
+ * keep their full size, so they are not shrunk after receiving. Buffers
+ * kept by a handler cannot be shrunk either, as the handler may point into
+ * them; the allocations that replace them are not counted as misses.
+ */
+static struct mbuf *udp_rxmb_get(struct udp_sock *us)
+{
+	while (us->rxpooln) {
+		struct mbuf *mb = us->rxpoolv[--us->rxpooln];
+
+		if (mb->size == us->rxsz) {
+			++us->rxpool_hits;
+			return mb;
+		}
+
+		mem_deref(mb);
+	}
+
+	if (us->rxpool_kept)
+		--us->rxpool_kept;
+	else if (us->rxpoolsz)
+		++us->rxpool_misses;
+
+	return mbuf_alloc(us->rxsz);
+}
+
+
+static void udp_rxmb_put(struct udp_sock *us, struct mbuf *mb)
+{
+	if (mb && mem_nrefs(mb) == 1 && mb->size == us->rxsz &&
+	    us->rxpooln < us->rxpoolsz) {
+		us->rxpoolv[us->rxpooln++] = mb;
+		return;
+	}
+
+	if (mb && mem_nrefs(mb) > 1 && us->rxpoolsz)
+		++us->rxpool_kept;
+
+	mem_deref(mb);
+}
+
+
+#ifdef UDP_TSTAMP
+/*
+ * Kernel timestamps are taken from the realtime clock. They are moved to
+ * the monotonic clock of tmr_jiffies(), with an offset that is sampled
+ * once per read call.
+ */
+static void udp_tstamp_sync(struct udp_sock *us)
+{
+	struct timespec rt, mono;
+
+	if (clock_gettime(CLOCK_REALTIME, &rt) ||
+	    clock_gettime(CLOCK_MONOTONIC, &mono)) {
+		us->tsoff = 0;
+		return;
+	}
+
+	us->tsoff = ((int64_t)mono.tv_sec - rt.tv_sec) * 1000000 +
+		(mono.tv_nsec - rt.tv_nsec) / 1000;
+}
+
+
+static uint64_t udp_tstamp_get(const struct udp_sock *us,
+			       struct msghdr *msg)
+{
+	struct cmsghdr *cmsg;
+
+	for (cmsg = CMSG_FIRSTHDR(msg); cmsg; cmsg = CMSG_NXTHDR(msg, cmsg)) {
+
+		struct timespec ts;
+		int64_t usec;
+
+		if (cmsg->cmsg_level != SOL_SOCKET ||
+		    cmsg->cmsg_type != SCM_TIMESTAMPNS)
+			continue;
+
+		memcpy(&ts, CMSG_DATA(cmsg), sizeof(ts));
+
+		usec = (int64_t)ts.tv_sec * 1000000 + ts.tv_nsec / 1000 +
+			us->tsoff;
+
+		return usec > 0 ? (uint64_t)usec : 0;
+	}
+
+	return 0;
+}
+
+
+/* Receive one datagram with its kernel timestamp */
+static ssize_t udp_recv_tstamp(struct udp_sock *us, int fd, void *buf,
+			       size_t len, struct sa *src)
+{
+	union {
+		char buf[CMSG_SPACE(sizeof(struct timespec))];
+		size_t align;  /* alignment of struct cmsghdr */
+	} ctrl;
+	struct msghdr msg;
+	struct iovec iov;
+	ssize_t n;
+
+	iov.iov_base = buf;
+	iov.iov_len  = len;
+
+	memset(&msg, 0, sizeof(msg));
+	msg.msg_name       = &src->u.sa;
+	msg.msg_namelen    = src->len;
+	msg.msg_iov        = &iov;
+	msg.msg_iovlen     = 1;
+	msg.msg_control    = ctrl.buf;
+	msg.msg_controllen = sizeof(ctrl.buf);
+
+	n = recvmsg(fd, &msg, 0);
+	if (n < 0)
+		return n;
+
+	src->len = msg.msg_namelen;
+
+	udp_tstamp_sync(us);
+	us->rx_ts = udp_tstamp_get(us, &msg);
+
+	return n;
+}
+#endif
+
+
+static int udp_read(struct udp_sock *us, int fd)
+{
+	struct mbuf *mb = udp_rxmb_get(us);
+	const bool pool = us->rxpoolsz > 0;
+	struct sa src;
 	int err = 0;
 	ssize_t n;
 
 	if (!mb)
-		return;
+		return ENOMEM;
 
 	src.len = sizeof(src.u);
+#ifdef UDP_TSTAMP
+	if (us->tstamp)
+		n = udp_recv_tstamp(us, fd, mb->buf + us->rx_presz,
+				    mb->size - us->rx_presz, &src);
+	else
+#endif
 	n = recvfrom(fd, BUF_CAST mb->buf + us->rx_presz,
 		     mb->size - us->rx_presz, 0,
 		     &src.u.sa, &src.len);
@@ -149,8 +368,10 @@ static void udp_read(struct udp_sock *us, int fd)
 			goto out;
 
 #ifdef EWOULDBLOCK
-		if (EWOULDBLOCK == err)
+		if (EWOULDBLOCK == err) {
+			err = EAGAIN;
 			goto out;
+		}
 #endif
 
 #if TARGET_OS_IPHONE
@@ -189,37 +410,354 @@ static void udp_read(struct udp_sock *us, int fd)
 
 			udp_thread_attach(us);
 
+			err = EAGAIN;
 			goto out;
 		}
 #endif
 		if (us->eh)
 			us->eh(err, us->arg);
 
+		err = 0;
 		goto out;
 	}
 
 	mb->pos = us->rx_presz;
 	mb->end = n + us->rx_presz;
 
-	(void)mbuf_resize(mb, mb->end);
+	if (!pool) {
+		(void)mbuf_resize(mb, mb->end);
 
-	/* call helpers */
-	le = us->helpers.head;
-	while (le) {
-		struct udp_helper *uh = le->data;
-		bool hdld;
+		udp_recv_dispatch(us, &src, mb);
+		goto out;
+	}
 
-		le = le->next;
+	/* handlers may close the socket, which owns the pool */
+	mem_ref(us);
 
-		hdld = uh->recvh(&src, mb, uh->arg);
-		if (hdld)
-			goto out;
+	udp_recv_dispatch(us, &src, mb);
+
+	if (mem_nrefs(us) > 1) {
+		udp_rxmb_put(us, mb);
+		mb = NULL;
 	}
 
-	us->rh(&src, mb, us->arg);
+	mem_deref(us);
 
  out:
 	mem_deref(mb);
+
+	return err;
+}
+
+
+#ifdef UDP_RECVMMSG
+/*
+ * Receive up to n datagrams with one recvmmsg() call into the preallocated
+ * buffers, and dispatch them. Consumed buffers are replaced on the next
+ * call, so only buffers that were filled are allocated again.
+ */
+static int udp_read_batch(struct udp_sock *us, int fd, uint32_t n,
+			  uint32_t *cntp)
+{
+	struct mmsghdr msgv[UDP_RXBATCH_MAX];
+	struct iovec iov[UDP_RXBATCH_MAX];
+	struct mbuf *mbv[UDP_RXBATCH_MAX];
+	struct sa srcv[UDP_RXBATCH_MAX];
+#ifdef UDP_TSTAMP
+	union {
+		char buf[CMSG_SPACE(sizeof(struct timespec))];
+		size_t align;  /* alignment of struct cmsghdr */
+	} ctrlv[UDP_RXBATCH_MAX];
+#endif
+	uint32_t i;
+	int r, err = 0;
+
+	*cntp = 0;
+
+	if (!us->rxmbv) {
+		us->rxmbv = mem_zalloc(UDP_RXBATCH_MAX * sizeof(*us->rxmbv),
+				       NULL);
+		if (!us->rxmbv)
+			return ENOMEM;
+	}
+
+	n = min(n, (uint32_t)UDP_RXBATCH_MAX);
+
+	for (i=0; i<n; i++) {
+		struct mbuf *mb = us->rxmbv[i];
+
+		if (mb && mb->size != us->rxsz)
+			mb = us->rxmbv[i] = mem_deref(mb);
+
+		if (!mb) {
+			mb = us->rxmbv[i] = udp_rxmb_get(us);
+			if (!mb)
+				break;
+		}
+
+		iov[i].iov_base = mb->buf + us->rx_presz;
+		iov[i].iov_len  = mb->size - us->rx_presz;
+
+		memset(&msgv[i], 0, sizeof(msgv[i]));
+		msgv[i].msg_hdr.msg_name    = &srcv[i].u.sa;
+		msgv[i].msg_hdr.msg_namelen = sizeof(srcv[i].u);
+		msgv[i].msg_hdr.msg_iov     = &iov[i];
+		msgv[i].msg_hdr.msg_iovlen  = 1;
+#ifdef UDP_TSTAMP
+		if (us->tstamp) {
+			msgv[i].msg_hdr.msg_control    = ctrlv[i].buf;
+			msgv[i].msg_hdr.msg_controllen = sizeof(ctrlv[i].buf);
+		}
+#endif
+	}
+
+	if (!i)
+		return ENOMEM;
+
+	r = recvmmsg(fd, msgv, i, MSG_DONTWAIT, NULL);
+	if (r < 0) {
+		err = errno;
+
+		if (EAGAIN == err || EWOULDBLOCK == err)
+			return EAGAIN;
+
+		if (us->eh)
+			us->eh(err, us->arg);
+
+		*cntp = 1;
+		return 0;
+	}
+
+	/* handlers may close the socket, take the buffers first */
+	for (i=0; i<(uint32_t)r; i++) {
+		mbv[i] = us->rxmbv[i];
+		us->rxmbv[i] = NULL;
+	}
+
+#ifdef UDP_TSTAMP
+	if (us->tstamp)
+		udp_tstamp_sync(us);
+#endif
+
+	for (i=0; i<(uint32_t)r; i++) {
+		struct mbuf *mb = mbv[i];
+
+		if (mem_nrefs(us) > 1) {
+
+			srcv[i].len = msgv[i].msg_hdr.msg_namelen;
+
+			mb->pos = us->rx_presz;
+			mb->end = msgv[i].msg_len + us->rx_presz;
+
+			if (!us->rxpoolsz)
+				(void)mbuf_resize(mb, mb->end);
+
+#ifdef UDP_TSTAMP
+			if (us->tstamp)
+				us->rx_ts = udp_tstamp_get(us,
+							   &msgv[i].msg_hdr);
+#endif
+
+			udp_recv_dispatch(us, &srcv[i], mb);
+		}
+
+		if (mem_nrefs(us) > 1)
+			udp_rxmb_put(us, mb);
+		else
+			mem_deref(mb);
+	}
+
+	*cntp = r;
+
+	/* a short batch means the socket was drained */
+	return ((uint32_t)r < n) ? EAGAIN : 0;
+}
+#endif
+
+
+#ifdef UDP_OFFLOAD
+/*
+ * Receive one datagram that may have been coalesced by GRO, and split it
+ * into one buffer per segment. All segments have the size that is given
+ * in the UDP_GRO control message, except for the last one.
+ */
+static int udp_read_gro(struct udp_sock *us, int fd)
+{
+	union {
+		char buf[CMSG_SPACE(sizeof(int))
+#ifdef UDP_TSTAMP
+			 + CMSG_SPACE(sizeof(struct timespec))
+#endif
+			 ];
+		size_t align;  /* alignment of struct cmsghdr */
+	} ctrl;
+	struct cmsghdr *cmsg;
+	struct msghdr msg;
+	struct iovec iov;
+	struct sa src;
+	size_t segsz = 0, off;
+	ssize_t n;
+	int err = 0;
+
+	if (!us->grobuf) {
+		us->grobuf = mem_alloc(UDP_GRO_BUFSZ, NULL);
+		if (!us->grobuf)
+			return ENOMEM;
+	}
+
+	iov.iov_base = us->grobuf;
+	iov.iov_len  = UDP_GRO_BUFSZ;
+
+	memset(&msg, 0, sizeof(msg));
+	msg.msg_name       = &src.u.sa;
+	msg.msg_namelen    = sizeof(src.u);
+	msg.msg_iov        = &iov;
+	msg.msg_iovlen     = 1;
+	msg.msg_control    = ctrl.buf;
+	msg.msg_controllen = sizeof(ctrl.buf);
+
+	n = recvmsg(fd, &msg, MSG_DONTWAIT);
+	if (n < 0) {
+		err = errno;
+
+		if (EAGAIN == err || EWOULDBLOCK == err)
+			return EAGAIN;
+
+		if (us->eh)
+			us->eh(err, us->arg);
+
+		return 0;
+	}
+
+	src.len = msg.msg_namelen;
+
+	for (cmsg = CMSG_FIRSTHDR(&msg); cmsg;
+	     cmsg = CMSG_NXTHDR(&msg, cmsg)) {
+
+		if (cmsg->cmsg_level == SOL_UDP &&
+		    cmsg->cmsg_type == UDP_GRO) {
+			int v;
+
+			memcpy(&v, CMSG_DATA(cmsg), sizeof(v));
+			segsz = v > 0 ? (size_t)v : 0;
+		}
+	}
+
+	if (!segsz)
+		segsz = n;
+
+#ifdef UDP_TSTAMP
+	/* all segments share the timestamp of the coalesced datagram */
+	if (us->tstamp) {
+		udp_tstamp_sync(us);
+		us->rx_ts = udp_tstamp_get(us, &msg);
+	}
+#endif
+
+	/* handlers may close the socket, which owns the GRO buffer */
+	mem_ref(us);
+
+	for (off = 0; off < (size_t)n && mem_nrefs(us) > 1; off += segsz) {
+
+		const size_t len = min(segsz, (size_t)n - off);
+		struct mbuf *mb;
+
+		if (us->rx_presz + len <= us->rxsz)
+			mb = udp_rxmb_get(us);
+		else
+			mb = mbuf_alloc(us->rx_presz + len);
+
+		if (!mb) {
+			err = ENOMEM;
+			break;
+		}
+
+		memcpy(mb->buf + us->rx_presz, us->grobuf + off, len);
+		mb->pos = us->rx_presz;
+		mb->end = us->rx_presz + len;
+
+		udp_recv_dispatch(us, &src, mb);
+
+		if (mem_nrefs(us) > 1)
+			udp_rxmb_put(us, mb);
+		else
+			mem_deref(mb);
+	}
+
+	mem_deref(us);
+
+	return err;
+}
+#endif
+
+
+/* Read one datagram, or a batch of up to n datagrams where available */
+static int udp_read_some(struct udp_sock *us, int fd, uint32_t n,
+			 uint32_t *cntp)
+{
+#ifdef UDP_OFFLOAD
+	if (us->gro) {
+		*cntp = 1;
+		return udp_read_gro(us, fd);
+	}
+#endif
+#ifdef UDP_RECVMMSG
+	if (n > 1)
+		return udp_read_batch(us, fd, n, cntp);
+#else
+	(void)n;
+#endif
+	*cntp = 1;
+	return udp_read(us, fd);
+}
+
+
+/*
+ * Read up to rxbudget datagrams. With a budget larger than one the socket
+ * is polled edge-triggered, so it is re-armed if the budget ran out before
+ * the socket was drained. If the budget was lowered to one after the
+ * socket was attached edge-triggered, it is switched back to
+ * level-triggered polling. Where available, datagrams are received in
+ * batches with recvmmsg().
+ */
+static void udp_read_burst(struct udp_sock *us, int fd, fd_h *fh)
+{
+	bool *edge = (fd == us->fd6) ? &us->edge6 : &us->edge;
+	uint32_t i, cnt;
+	int err = 0;
+
+	if (us->rxbudget <= 1 && !*edge) {
+		(void)udp_read_some(us, fd, 1, &cnt);
+		return;
+	}
+
+	mem_ref(us);
+
+	for (i=0; i<us->rxbudget; i+=cnt) {
+
+		err = udp_read_some(us, fd, us->rxbudget - i, &cnt);
+		if (err)
+			break;
+
+		/* socket was deref'd or replaced from a handler */
+		if (mem_nrefs(us) == 1 || (fd != us->fd && fd != us->fd6)) {
+			err = EAGAIN;
+			break;
+		}
+	}
+
+	if (mem_nrefs(us) > 1 && (fd == us->fd || fd == us->fd6)) {
+
+		if (us->rxbudget <= 1) {
+			*edge = false;
+			(void)fd_listen(fd, FD_READ, fh, us);
+		}
+		else if (err != EAGAIN) {
+			(void)fd_listen(fd, FD_READ | FD_EDGE, fh, us);
+		}
+	}
+
+	mem_deref(us);
 }
 
 
@@ -229,7 +767,7 @@ static void udp_read_handler(int flags, void *arg)
 
 	(void)flags;
 
-	udp_read(us, us->fd);
+	udp_read_burst(us, us->fd, udp_read_handler);
 }
 
 
@@ -239,22 +777,12 @@ static void udp_read_handler6(int flags, void *arg)
 
 	(void)flags;
 
-	udp_read(us, us->fd6);
+	udp_read_burst(us, us->fd6, udp_read_handler6);
 }
 
 
-/**
- * Create and listen on a UDP Socket
- *
- * @param usp   Pointer to returned UDP Socket
- * @param local Local network address
- * @param rh    Receive handler
- * @param arg   Handler argument
- *
- * @return 0 if success, otherwise errorcode
- */
-int udp_listen(struct udp_sock **usp, const struct sa *local,
-	       udp_recv_h *rh, void *arg)
+static int udp_listen_internal(struct udp_sock **usp, const struct sa *local,
+			       udp_recv_h *rh, void *arg, bool reuse)
 {
 	struct addrinfo hints, *res = NULL, *r;
 	struct udp_sock *us = NULL;
@@ -329,6 +857,16 @@ int udp_listen(struct udp_sock **usp, const struct sa *local,
 			continue;
 		}
 
+		if (reuse) {
+			err = net_sockopt_reuseport_set(fd, true);
+			if (err) {
+				DEBUG_WARNING("udp listen: reuse set: %m\n",
+					      err);
+				(void)close(fd);
+				continue;
+			}
+		}
+
 		if (bind(fd, r->ai_addr, SIZ_CAST r->ai_addrlen) < 0) {
 			err = errno;
 			DEBUG_INFO("listen: bind(): %m (%J)\n", err, local);
@@ -380,6 +918,7 @@ int udp_listen(struct udp_sock **usp, const struct sa *local,
 	us->rh   = rh ? rh : dummy_udp_recv_handler;
 	us->arg  = arg;
 	us->rxsz = UDP_RXSZ_DEFAULT;
+	us->rxbudget = UDP_RXBUDGET_DEFAULT;
 
  out:
 	if (err)
@@ -391,6 +930,46 @@ int udp_listen(struct udp_sock **usp, const struct sa *local,
 }
 
 
+/**
+ * Create and listen on a UDP Socket
+ *
+ * @param usp   Pointer to returned UDP Socket
+ * @param local Local network address
+ * @param rh    Receive handler
+ * @param arg   Handler argument
+ *
+ * @return 0 if success, otherwise errorcode
+ */
+int udp_listen(struct udp_sock **usp, const struct sa *local,
+	       udp_recv_h *rh, void *arg)
+{
+	return udp_listen_internal(usp, local, rh, arg, false);
+}
+
+
+/**
+ * Create and listen on a UDP Socket that shares its local address with
+ * other sockets (SO_REUSEPORT). The kernel distributes incoming datagrams
+ * over all sockets bound to the same address, which allows one socket per
+ * event loop thread, see re_pool_alloc().
+ *
+ * @param usp   Pointer to returned UDP Socket
+ * @param local Local network address, with a fixed port
+ * @param rh    Receive handler
+ * @param arg   Handler argument
+ *
+ * @return 0 if success, otherwise errorcode
+ */
+int udp_listen_reuseport(struct udp_sock **usp, const struct sa *local,
+			 udp_recv_h *rh, void *arg)
+{
+	if (!local || !sa_port(local))
+		return EINVAL;
+
+	return udp_listen_internal(usp, local, rh, arg, true);
+}
+
+
 /**
  * Create an UDP socket with specified address family.
  *
@@ -414,6 +993,7 @@ int udp_open(struct udp_sock **usp, int af)
 
 	us->fd  = -1;
 	us->fd6 = -1;
+	us->rxbudget = UDP_RXBUDGET_DEFAULT;
 
 	fd = SOK_CAST socket(af, SOCK_DGRAM, IPPROTO_UDP);
 	if (fd < 0) {
@@ -467,6 +1047,23 @@ int udp_connect(struct udp_sock *us, const struct sa *peer)
 }
 
 
+/* call helpers in reverse order, true if handled or failed */
+static bool udp_helpers_send(struct le *le, int *err, struct sa *dst,
+			     struct mbuf *mb)
+{
+	while (le) {
+		struct udp_helper *uh = le->data;
+
+		le = le->prev;
+
+		if (uh->sendh(err, dst, mb, uh->arg) || *err)
+			return true;
+	}
+
+	return false;
+}
+
+
 static int udp_send_internal(struct udp_sock *us, const struct sa *dst,
 			     struct mbuf *mb, struct le *le)
 {
@@ -479,18 +1076,11 @@ static int udp_send_internal(struct udp_sock *us, const struct sa *dst,
 	else
 		fd = us->fd;
 
-	/* call helpers in reverse order */
-	while (le) {
-		struct udp_helper *uh = le->data;
-
-		le = le->prev;
-
-		if (dst != &hdst) {
-			sa_cpy(&hdst, dst);
-			dst = &hdst;
-		}
+	if (le) {
+		sa_cpy(&hdst, dst);
+		dst = &hdst;
 
-		if (uh->sendh(&err, &hdst, mb, uh->arg) || err)
+		if (udp_helpers_send(le, &err, &hdst, mb))
 			return err;
 	}
 
@@ -510,6 +1100,153 @@ static int udp_send_internal(struct udp_sock *us, const struct sa *dst,
 }
 
 
+/** Datagrams of a batch that are ready to be sent on one socket */
+struct udp_txbatch {
+	struct udp_dgram *dv[UDP_TXBATCH_MAX];
+	struct sa dstv[UDP_TXBATCH_MAX];
+	unsigned n;
+	int fd;
+};
+
+
+#ifdef UDP_OFFLOAD
+/*
+ * Count the datagrams from index i that can be sent as one GSO message:
+ * same destination, and equal size except for the last one.
+ */
+static unsigned udp_gso_count(const struct udp_sock *us,
+			      const struct udp_txbatch *b,
+			      const struct iovec *iov, unsigned i)
+{
+	const size_t segsz = iov[i].iov_len;
+	size_t total = segsz;
+	unsigned k;
+
+	if (!segsz)
+		return 1;
+
+	for (k=1; i+k < b->n && k < UDP_GSO_SEGS_MAX; k++) {
+
+		const size_t len = iov[i+k].iov_len;
+
+		if (iov[i+k-1].iov_len != segsz || !len || len > segsz)
+			break;
+
+		if (total + len > UDP_GSO_BYTES_MAX)
+			break;
+
+		if (!us->conn && !sa_cmp(&b->dstv[i], &b->dstv[i+k], SA_ALL))
+			break;
+
+		total += len;
+	}
+
+	return k;
+}
+#endif
+
+
+static void udp_txbatch_flush(const struct udp_sock *us,
+			      struct udp_txbatch *b)
+{
+#ifdef UDP_SENDMMSG
+	struct mmsghdr msgv[UDP_TXBATCH_MAX];
+	struct iovec iov[UDP_TXBATCH_MAX];
+	unsigned firstv[UDP_TXBATCH_MAX + 1];
+#ifdef UDP_OFFLOAD
+	union {
+		char buf[CMSG_SPACE(sizeof(uint16_t))];
+		size_t align;  /* alignment of struct cmsghdr */
+	} ctrlv[UDP_TXBATCH_MAX];
+#endif
+	unsigned m = 0, k;
+#endif
+	unsigned i;
+
+#ifdef UDP_SENDMMSG
+	for (i=0; i<b->n; i++) {
+		struct mbuf *mb = b->dv[i]->mb;
+
+		iov[i].iov_base = mb->buf + mb->pos;
+		iov[i].iov_len  = mb->end - mb->pos;
+	}
+
+	/* one message per datagram, or per run of GSO segments */
+	for (i=0; i<b->n; i+=k) {
+
+		k = 1;
+
+#ifdef UDP_OFFLOAD
+		if (us->gso)
+			k = udp_gso_count(us, b, iov, i);
+#endif
+
+		memset(&msgv[m], 0, sizeof(msgv[m]));
+		msgv[m].msg_hdr.msg_iov    = &iov[i];
+		msgv[m].msg_hdr.msg_iovlen = k;
+
+		if (!us->conn) {
+			msgv[m].msg_hdr.msg_name    = &b->dstv[i].u.sa;
+			msgv[m].msg_hdr.msg_namelen = b->dstv[i].len;
+		}
+
+#ifdef UDP_OFFLOAD
+		if (k > 1) {
+			const uint16_t segsz = (uint16_t)iov[i].iov_len;
+			struct cmsghdr *cmsg;
+
+			memset(ctrlv[m].buf, 0, sizeof(ctrlv[m].buf));
+			msgv[m].msg_hdr.msg_control    = ctrlv[m].buf;
+			msgv[m].msg_hdr.msg_controllen = sizeof(ctrlv[m].buf);
+
+			cmsg = CMSG_FIRSTHDR(&msgv[m].msg_hdr);
+			cmsg->cmsg_level = SOL_UDP;
+			cmsg->cmsg_type  = UDP_SEGMENT;
+			cmsg->cmsg_len   = CMSG_LEN(sizeof(segsz));
+			memcpy(CMSG_DATA(cmsg), &segsz, sizeof(segsz));
+		}
+#endif
+
+		firstv[m++] = i;
+	}
+
+	firstv[m] = b->n;
+
+	/* an error is reported for the first message that was not sent */
+	for (i=0; i<m;) {
+		int r = sendmmsg(b->fd, &msgv[i], m - i, 0);
+
+		if (r < 0) {
+			const int err = errno;
+
+			for (k=firstv[i]; k<firstv[i+1]; k++)
+				b->dv[k]->err = err;
+			++i;
+		}
+		else
+			i += r;
+	}
+#else
+	for (i=0; i<b->n; i++) {
+		struct mbuf *mb = b->dv[i]->mb;
+		ssize_t r;
+
+		if (us->conn)
+			r = send(b->fd, BUF_CAST mb->buf + mb->pos,
+				 mb->end - mb->pos, 0);
+		else
+			r = sendto(b->fd, BUF_CAST mb->buf + mb->pos,
+				   mb->end - mb->pos, 0,
+				   &b->dstv[i].u.sa, b->dstv[i].len);
+		if (r < 0)
+			b->dv[i]->err = errno;
+	}
+#endif
+
+	b->n = 0;
+}
+
+
 /**
  * Send a UDP Datagram to a peer
  *
@@ -528,6 +1265,83 @@ int udp_send(struct udp_sock *us, const struct sa *dst, struct mbuf *mb)
 }
 
 
+/**
+ * Send a batch of UDP Datagrams, e.g. one RTP packet to many peers. The
+ * send helpers are called for each datagram, and the datagrams are sent
+ * with as few system calls as possible (sendmmsg() where available).
+ * If enabled with udp_gso_set(), equal-sized datagrams to the same
+ * destination are sent with segmentation offload.
+ *
+ * @param us  UDP Socket
+ * @param dv  Vector of datagrams, the result is returned in each err field
+ * @param n   Number of datagrams
+ *
+ * @return 0 if all datagrams were sent, otherwise the first errorcode
+ */
+int udp_send_batch(struct udp_sock *us, struct udp_dgram *dv, size_t n)
+{
+	struct udp_txbatch b;
+	size_t i;
+
+	if (!us || (!dv && n))
+		return EINVAL;
+
+	b.n  = 0;
+	b.fd = -1;
+
+	for (i=0; i<n; i++) {
+		struct udp_dgram *d = &dv[i];
+		int fd;
+
+		d->err = 0;
+
+		if (!d->dst || !d->mb) {
+			d->err = EINVAL;
+			continue;
+		}
+
+		if (AF_INET6 == sa_af(d->dst) && -1 != us->fd6)
+			fd = us->fd6;
+		else
+			fd = us->fd;
+
+		if (b.n && (fd != b.fd || b.n == UDP_TXBATCH_MAX))
+			udp_txbatch_flush(us, &b);
+
+		/* helpers may modify a buffer that is already queued */
+		if (b.n && us->helpers.tail) {
+			unsigned j;
+
+			for (j=0; j<b.n; j++) {
+				if (b.dv[j]->mb == d->mb) {
+					udp_txbatch_flush(us, &b);
+					break;
+				}
+			}
+		}
+
+		sa_cpy(&b.dstv[b.n], d->dst);
+
+		if (udp_helpers_send(us->helpers.tail, &d->err,
+				     &b.dstv[b.n], d->mb))
+			continue;
+
+		b.dv[b.n++] = d;
+		b.fd = fd;
+	}
+
+	if (b.n)
+		udp_txbatch_flush(us, &b);
+
+	for (i=0; i<n; i++) {
+		if (dv[i].err)
+			return dv[i].err;
+	}
+
+	return 0;
+}
+
+
 /**
  * Send an anonymous UDP Datagram to a peer
  *
@@ -682,6 +1496,235 @@ void udp_rxbuf_presz_set(struct udp_sock *us, size_t rx_presz)
 }
 
 
+/**
+ * Set the size of the receive buffer pool on a UDP Socket. Buffers of
+ * rxsz bytes are recycled if the receive handler does not keep a
+ * reference, instead of being allocated and shrunk for every datagram.
+ *
+ * @note Buffers that the receive handler keeps, e.g. in a jitter buffer,
+ *       keep their full capacity of rxsz bytes. With small datagrams,
+ *       consider a smaller rxsz or copying the data to be kept.
+ *
+ * @param us UDP Socket
+ * @param n  Maximum number of pooled buffers, 0 to disable the pool
+ *
+ * @return 0 if success, otherwise errorcode
+ */
+int udp_rxpool_set(struct udp_sock *us, uint32_t n)
+{
+	struct mbuf **poolv;
+
+	if (!us)
+		return EINVAL;
+
+	while (us->rxpooln > n)
+		mem_deref(us->rxpoolv[--us->rxpooln]);
+
+	if (!n) {
+		us->rxpool_kept = 0;
+		us->rxpoolv  = mem_deref(us->rxpoolv);
+		us->rxpoolsz = 0;
+		return 0;
+	}
+
+	poolv = mem_reallocarray(us->rxpoolv, n, sizeof(*poolv), NULL);
+	if (!poolv)
+		return ENOMEM;
+
+	us->rxpoolv  = poolv;
+	us->rxpoolsz = n;
+
+	return 0;
+}
+
+
+/**
+ * Get the receive buffer pool counters of a UDP Socket
+ *
+ * @param us     UDP Socket
+ * @param hits   Returned number of buffers taken from the pool (optional)
+ * @param misses Returned number of buffers allocated with the pool
+ *               enabled, not counting replacements of buffers kept by
+ *               the receive handler (optional)
+ */
+void udp_rxpool_stats(const struct udp_sock *us, uint64_t *hits,
+		      uint64_t *misses)
+{
+	if (hits)
+		*hits = us ? us->rxpool_hits : 0;
+	if (misses)
+		*misses = us ? us->rxpool_misses : 0;
+}
+
+
+/**
+ * Set the maximum number of datagrams read per receive event. A budget
+ * larger than one drains the socket until it would block, and makes
+ * udp_thread_attach() poll the socket edge-triggered. Lowering the budget
+ * to one on an attached socket switches it back to level-triggered
+ * polling on the next receive event.
+ *
+ * @param us     UDP Socket
+ * @param budget Maximum number of datagrams per event
+ */
+void udp_rxbudget_set(struct udp_sock *us, uint32_t budget)
+{
+	if (!us)
+		return;
+
+	us->rxbudget = budget ? budget : UDP_RXBUDGET_DEFAULT;
+}
+
+
+/**
+ * Enable or disable UDP segmentation offload (GSO) for udp_send_batch().
+ * Runs of equal-sized datagrams to the same destination are then passed
+ * to the kernel as one message, which is segmented as late as possible.
+ *
+ * @param us     UDP Socket
+ * @param enable True to enable, false to disable
+ *
+ * @return 0 if success, ENOSYS if not supported, otherwise errorcode
+ */
+int udp_gso_set(struct udp_sock *us, bool enable)
+{
+#ifdef UDP_OFFLOAD
+	int err;
+	int v = 0;
+
+	if (!us)
+		return EINVAL;
+
+	/* probe for kernel support, a segment size of 0 is the default */
+	if (enable) {
+		err = udp_setsockopt(us, SOL_UDP, UDP_SEGMENT, &v, sizeof(v));
+		if (err)
+			return err == ENOPROTOOPT ? ENOSYS : err;
+	}
+
+	us->gso = enable;
+
+	return 0;
+#else
+	(void)enable;
+
+	return us ? ENOSYS : EINVAL;
+#endif
+}
+
+
+/**
+ * Enable or disable receiving of datagrams that were coalesced by the
+ * kernel (GRO). Coalesced datagrams are split again, and the helpers and
+ * receive handler are called once per original datagram.
+ *
+ * @param us     UDP Socket
+ * @param enable True to enable, false to disable
+ *
+ * @return 0 if success, ENOSYS if not supported, otherwise errorcode
+ */
+int udp_gro_set(struct udp_sock *us, bool enable)
+{
+#ifdef UDP_OFFLOAD
+	int err;
+	int v = enable;
+
+	if (!us)
+		return EINVAL;
+
+	err = udp_setsockopt(us, SOL_UDP, UDP_GRO, &v, sizeof(v));
+	if (err)
+		return err == ENOPROTOOPT ? ENOSYS : err;
+
+	us->gro = enable;
+
+	return 0;
+#else
+	(void)enable;
+
+	return us ? ENOSYS : EINVAL;
+#endif
+}
+
+
+/**
+ * Enable or disable kernel receive timestamps (SO_TIMESTAMPNS). The
+ * arrival time of the current datagram can then be read with
+ * udp_rx_tstamp() from the receive handler.
+ *
+ * @param us     UDP Socket
+ * @param enable True to enable, false to disable
+ *
+ * @return 0 if success, ENOSYS if not supported, otherwise errorcode
+ */
+int udp_tstamp_set(struct udp_sock *us, bool enable)
+{
+#ifdef UDP_TSTAMP
+	int err;
+	int v = enable;
+
+	if (!us)
+		return EINVAL;
+
+	err = udp_setsockopt(us, SOL_SOCKET, SO_TIMESTAMPNS, &v, sizeof(v));
+	if (err)
+		return err == ENOPROTOOPT ? ENOSYS : err;
+
+	us->tstamp = enable;
+	us->rx_ts  = 0;
+
+	return 0;
+#else
+	(void)enable;
+
+	return us ? ENOSYS : EINVAL;
+#endif
+}
+
+
+/**
+ * Get the kernel arrival time of the datagram that is being received.
+ * This is only valid from within the helpers and receive handler.
+ *
+ * @param us UDP Socket
+ *
+ * @return Arrival time in [us] on the tmr_jiffies() clock, 0 if unknown
+ */
+uint64_t udp_rx_tstamp(const struct udp_sock *us)
+{
+	return us ? us->rx_ts : 0;
+}
+
+
+/**
+ * Set the busy polling time on receive (SO_BUSY_POLL). The kernel then
+ * polls the device queue instead of waiting for an interrupt, which trades
+ * CPU time for lower receive latency
+ *
+ * @param us   UDP Socket
+ * @param usec Busy polling time in [us], 0 to disable
+ *
+ * @return 0 if success, ENOSYS if not supported, otherwise errorcode
+ *
+ * @note Values above the net.core.busy_read sysctl need CAP_NET_ADMIN
+ */
+int udp_busy_poll_set(struct udp_sock *us, uint32_t usec)
+{
+#ifdef SO_BUSY_POLL
+	int v = (int)usec;
+
+	if (!us)
+		return EINVAL;
+
+	return udp_setsockopt(us, SOL_SOCKET, SO_BUSY_POLL, &v, sizeof(v));
+#else
+	(void)usec;
+
+	return us ? ENOSYS : EINVAL;
+#endif
+}
+
+
 /**
  * Set receive handler on a UDP Socket
  *
@@ -745,19 +1788,26 @@ int udp_sock_fd(const struct udp_sock *us, int af)
  */
 int udp_thread_attach(struct udp_sock *us)
 {
+	int flags = FD_READ;
 	int err = 0;
 
 	if (!us)
 		return EINVAL;
 
+	if (us->rxbudget > 1)
+		flags |= FD_EDGE;
+
+	us->edge  = (flags & FD_EDGE) != 0;
+	us->edge6 = us->edge;
+
 	if (-1 != us->fd) {
-		err = fd_listen(us->fd, FD_READ, udp_read_handler, us);
+		err = fd_listen(us->fd, flags, udp_read_handler, us);
 		if (err)
 			goto out;
 	}
 
 	if (-1 != us->fd6) {
-		err = fd_listen(us->fd6, FD_READ, udp_read_handler6, us);
+		err = fd_listen(us->fd6, flags, udp_read_handler6, us);
 		if (err)
 			goto out;
 	}
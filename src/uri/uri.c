@@ -3,6 +3,7 @@
  *
  * Copyright (C) 2010 Creytiv.com
  */
+#include <ctype.h>
 #include <string.h>
 #include <re_types.h>
 #include <re_fmt.h>
@@ -72,6 +73,32 @@ int uri_encode(struct re_printf *pf, const struct uri *uri)
 }
 
 
+/*
+ * The decoders below are hand-written equivalents of the re_regex()
+ * expressions in the comments. Like re_regex() they try each start
+ * position in turn, and give up if a literal is missing at the end of
+ * the input.
+ */
+
+
+/* Skip characters that are not in the stop set */
+static inline const char *skip_to(const char *p, const char *end,
+				  const char *stop)
+{
+	while (p < end && !(*p && strchr(stop, *p)))
+		++p;
+
+	return p;
+}
+
+
+static inline void pl_range(struct pl *pl, const char *p, const char *end)
+{
+	pl->p = p;
+	pl->l = end - p;
+}
+
+
 /**
  * Decode host-port portion of a URI (if present)
  *
@@ -84,17 +111,158 @@ int uri_encode(struct re_printf *pf, const struct uri *uri)
 int uri_decode_hostport(const struct pl *hostport, struct pl *host,
 			struct pl *port)
 {
-	if (!hostport || !host || !port)
+	const char *s, *p, *end;
+
+	if (!hostport || !host || !port || !hostport->p)
 		return EINVAL;
 
-	/* Try IPv6 first */
-	if (!re_regex(hostport->p, hostport->l, "\\[[0-9a-f:]+\\][:]*[0-9]*",
-		      host, NULL, port))
+	end = hostport->p + hostport->l;
+
+	/* Try IPv6 first: "\[[0-9a-f:]+\][:]*[0-9]*" */
+	for (s = hostport->p; s < end; s++) {
+
+		if (*s != '[')
+			continue;
+
+		for (p = s + 1; p < end && (isxdigit((uint8_t)*p) || *p == ':');
+		     p++)
+			;
+
+		if (p == s + 1)
+			continue;
+		if (p == end)
+			break;
+		if (*p != ']')
+			continue;
+
+		pl_range(host, s + 1, p);
+
+		for (++p; p < end && *p == ':'; p++)
+			;
+
+		for (s = p; p < end && isdigit((uint8_t)*p); p++)
+			;
+
+		pl_range(port, s, p);
+
 		return 0;
+	}
+
+	/* Then non-IPv6 host: "[^:]+[:]*[0-9]*" */
+	for (s = hostport->p; s < end && *s == ':'; s++)
+		;
+
+	if (s == end)
+		return ENOENT;
+
+	p = skip_to(s, end, ":");
+	pl_range(host, s, p);
+
+	for (; p < end && *p == ':'; p++)
+		;
+
+	for (s = p; p < end && isdigit((uint8_t)*p); p++)
+		;
+
+	pl_range(port, s, p);
+
+	return 0;
+}
+
+
+/* "[^:]+:[^@:]*[:]*[^@]*@[^/;? ]+[^;? ]*[^?]*[^]*" */
+static int decode_userinfo(struct uri *uri, const struct pl *pl,
+			   struct pl *hostport)
+{
+	const char *end = pl->p + pl->l;
+	const char *s, *p, *q;
+
+	for (s = pl->p; s < end; s++) {
+
+		p = skip_to(s, end, ":");
+		if (p == s)
+			continue;
+		if (p == end)
+			return ENOENT;
+
+		pl_range(&uri->scheme, s, p);
+
+		q = ++p;
+		p = skip_to(p, end, "@:");
+		pl_range(&uri->user, q, p);
+
+		for (; p < end && *p == ':'; p++)
+			;
+
+		q = p;
+		p = skip_to(p, end, "@");
+		pl_range(&uri->password, q, p);
+
+		if (p == end)
+			return ENOENT;
+
+		q = ++p;
+		p = skip_to(p, end, "/;? ");
+		if (p == q)
+			continue;
+
+		pl_range(hostport, q, p);
+
+		q = p;
+		p = skip_to(p, end, ";? ");
+		pl_range(&uri->path, q, p);
+
+		q = p;
+		p = skip_to(p, end, "?");
+		pl_range(&uri->params, q, p);
+
+		pl_range(&uri->headers, p, end);
+
+		return 0;
+	}
+
+	return ENOENT;
+}
+
+
+/* "[^:]+:[^/;? ]+[^;? ]*[^?]*[^]*" */
+static int decode_host(struct uri *uri, const struct pl *pl,
+		       struct pl *hostport)
+{
+	const char *end = pl->p + pl->l;
+	const char *s, *p, *q;
+
+	for (s = pl->p; s < end; s++) {
+
+		p = skip_to(s, end, ":");
+		if (p == s)
+			continue;
+		if (p == end)
+			return ENOENT;
+
+		pl_range(&uri->scheme, s, p);
+
+		q = ++p;
+		p = skip_to(p, end, "/;? ");
+		if (p == q)
+			continue;
+
+		pl_range(hostport, q, p);
+
+		q = p;
+		p = skip_to(p, end, ";? ");
+		pl_range(&uri->path, q, p);
+
+		q = p;
+		p = skip_to(p, end, "?");
+		pl_range(&uri->params, q, p);
+
+		pl_range(&uri->headers, p, end);
+
+		return 0;
+	}
 
-	/* Then non-IPv6 host */
-	return re_regex(hostport->p, hostport->l, "[^:]+[:]*[0-9]*",
-			host, NULL, port);
+	return ENOENT;
 }
 
 
@@ -113,24 +281,18 @@ int uri_decode(struct uri *uri, const struct pl *pl)
 	struct pl hostport;
 	int err;
 
-	if (!uri || !pl)
+	if (!uri || !pl || !pl->p)
 		return EINVAL;
 
 	memset(uri, 0, sizeof(*uri));
-	if (0 == re_regex(pl->p, pl->l,
-			  "[^:]+:[^@:]*[:]*[^@]*@[^/;? ]+[^;? ]*[^?]*[^]*",
-			  &uri->scheme, &uri->user, NULL, &uri->password,
-			  &hostport, &uri->path, &uri->params,
-			  &uri->headers)) {
+	if (0 == decode_userinfo(uri, pl, &hostport)) {
 
 		if (0 == uri_decode_hostport(&hostport, &uri->host, &port))
 			goto out;
 	}
 
 	memset(uri, 0, sizeof(*uri));
-	err = re_regex(pl->p, pl->l, "[^:]+:[^/;? ]+[^;? ]*[^?]*[^]*",
-		       &uri->scheme, &hostport, &uri->path, &uri->params,
-		       &uri->headers);
+	err = decode_host(uri, pl, &hostport);
 	if (0 == err) {
 		err = uri_decode_hostport(&hostport, &uri->host, &port);
 		if (0 == err)